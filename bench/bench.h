@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_BENCH
+#define _HOMD_BENCH
+
+#include <chrono>
+#include <cstddef>
+
+// Length a timed round is calibrated to, and how many rounds run
+#define BENCH_ROUND_NS 20000000.0
+#define BENCH_ROUNDS 5
+// Slowdown over the baseline, in percent, that counts as a regression
+#define BENCH_DEFAULT_TOLERANCE 10.0
+
+// Heap allocations made through operator new since the program started
+using AllocCounts = struct AllocCounts {
+    size_t count;
+    size_t bytes;
+};
+
+AllocCounts allocCounts();
+
+// What measure found for one operation
+using BenchResult = struct BenchResult {
+    // Name of the operation, the same across runs
+    const char* name;
+    double nsPerOp;
+    // Units of work one operation does, for the throughput
+    double itemsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+};
+
+// Prints a result and keeps it for the baseline
+void recordResult(const BenchResult& result);
+
+/**
+ * Writes the kept results to a baseline file.
+ *
+ * @param path the file to write
+ *
+ * @return false if the file could not be written
+ */
+bool saveBaseline(const char* path);
+
+/**
+ * Compares the kept results against a baseline file. An operation
+ * regressed if it got slower by more than the tolerance or allocates more
+ * than it did.
+ *
+ * @param path the file saveBaseline wrote
+ * @param tolerance the slowdown allowed in percent
+ *
+ * @return the number of regressed operations, -1 if the file could not be
+ * read
+ */
+int compareBaseline(const char* path, double tolerance);
+
+/**
+ * Times an operation and records the result. The calls run in rounds
+ * calibrated to BENCH_ROUND_NS, the fastest of BENCH_ROUNDS counts.
+ *
+ * @param name the name of the operation, without spaces
+ * @param items the units of work one call does
+ * @param op the operation, called with the index of the call
+ */
+template <typename F>
+void measure(const char* name, double items, F op) {
+    auto run = [&op](long calls) {
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < calls; ++i) {
+            op((int)i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   end - start)
+            .count();
+    };
+
+    long calls = 1;
+    while (run(calls) < BENCH_ROUND_NS && calls < (1L << 30)) {
+        calls *= 2;
+    }
+
+    AllocCounts before = allocCounts();
+    double best = run(calls);
+    for (int round = 1; round < BENCH_ROUNDS; ++round) {
+        double ns = run(calls);
+        best = ns < best ? ns : best;
+    }
+    AllocCounts after = allocCounts();
+
+    double total = (double)calls * BENCH_ROUNDS;
+    recordResult({name, best / (double)calls, items,
+                  (double)(after.count - before.count) / total,
+                  (double)(after.bytes - before.bytes) / total});
+}
+
+// Times the math, mesh generation, culling and transform paths the
+// baseline covers
+int benchSuite();
+
+// Scaling of the job system at 1, 2, 4 and one thread per core
+int benchJobs();
+
+// Checks that packed vertex formats look like the float ones and reports
+// their size
+int benchVertexFormats();
+
+// Checks the mesh optimizer keeps the triangles of a mesh and reports the
+// vertex cache miss ratio before and after
+int benchMeshOptimizer();
+
+// Checks the SIMD frustum culling against a scalar reference and compares
+// their speed
+int benchCulling();
+
+// Checks the frustum, ray and nearest queries of the BVH against brute
+// force on 100k objects, before and after moving them, and times them
+int benchBvh();
+
+// Checks the detail levels of a gear get coarser with distance and do not
+// flap around a switch size, and reports their vertex counts
+int benchLod();
+
+// Checks the radix sort of the render queue against std::stable_sort and
+// compares their speed
+int benchSortKeys();
+
+#endif
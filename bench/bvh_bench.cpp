@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/culling.h>
+#include <scene/bvh.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Objects in the index, spread over a cube of WORLD_SIZE
+#define BVH_OBJECTS 100000
+#define WORLD_SIZE 2000.0F
+// Queries timed per kind
+#define BVH_QUERIES 1000
+
+static Aabb boxAround(const float center[3], float half) {
+    Aabb box;
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = center[axis] - half;
+        box.max[axis] = center[axis] + half;
+    }
+    return box;
+}
+
+// Milliseconds since start
+static double since(std::chrono::steady_clock::time_point start) {
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// A perspective frustum at the origin looking down -z
+static Frustum frustumAt(const float eye[3]) {
+    const float zNear = 1.0F;
+    const float zFar = 500.0F;
+    const float cotangent = 1.0F / std::tan(30.0F * (float)M_PI / 180.0F);
+    Mat4 projection{};
+    projection.m[0] = cotangent;
+    projection.m[5] = cotangent;
+    projection.m[10] = -(zFar + zNear) / (zFar - zNear);
+    projection.m[11] = -1.0F;
+    projection.m[14] = -2.0F * zNear * zFar / (zFar - zNear);
+    Mat4 view = Mat4::identity();
+    Mat4::translate(view.m, -eye[0], -eye[1], -eye[2]);
+    Mat4 clip = projection * view;
+    return extractFrustum(clip.m);
+}
+
+// Same plane test as the BVH, for the brute force reference
+static bool boxTouches(const Frustum& frustum, const Aabb& box) {
+    for (const Vec4& p : frustum.planes) {
+        float d = p.w;
+        d += p.x * (p.x > 0 ? box.max[0] : box.min[0]);
+        d += p.y * (p.y > 0 ? box.max[1] : box.min[1]);
+        d += p.z * (p.z > 0 ? box.max[2] : box.min[2]);
+        if (d < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Ray against box reference, infinite directions are left out
+static bool rayHits(const float o[3], const float d[3], const Aabb& b,
+                    float* t) {
+    float t0 = 0.0F;
+    float t1 = FLT_MAX;
+    for (int axis = 0; axis < 3; ++axis) {
+        float a = (b.min[axis] - o[axis]) / d[axis];
+        float c = (b.max[axis] - o[axis]) / d[axis];
+        t0 = std::max(t0, std::min(a, c));
+        t1 = std::min(t1, std::max(a, c));
+    }
+    *t = t0;
+    return t0 <= t1;
+}
+
+static float boxDistance(const float p[3], const Aabb& b) {
+    float d = 0.0F;
+    for (int axis = 0; axis < 3; ++axis) {
+        float out = std::max({b.min[axis] - p[axis], 0.0F,
+                              p[axis] - b.max[axis]});
+        d += out * out;
+    }
+    return std::sqrt(d);
+}
+
+// Checks every kind of query against brute force
+static bool checkQueries(const Bvh& bvh,
+                         const std::vector<Aabb>& boxes,
+                         std::mt19937& random) {
+    std::uniform_real_distribution<float> coord(-WORLD_SIZE / 2,
+                                                WORLD_SIZE / 2);
+    std::uniform_real_distribution<float> unit(-1.0F, 1.0F);
+    for (int q = 0; q < 20; ++q) {
+        float p[3] = {coord(random), coord(random), coord(random)};
+
+        Frustum frustum = frustumAt(p);
+        std::vector<int> found;
+        bvh.queryFrustum(frustum, found);
+        std::vector<int> expected;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            if (boxTouches(frustum, boxes[i])) {
+                expected.push_back((int)i);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        if (found != expected) {
+            printf("BVH frustum query found %zu objects, expected %zu\n",
+                   found.size(), expected.size());
+            return false;
+        }
+
+        float d[3] = {unit(random), unit(random), unit(random)};
+        float distance = 0.0F;
+        int hit = bvh.raycast(p, d, FLT_MAX, &distance);
+        float best = FLT_MAX;
+        for (const Aabb& box : boxes) {
+            float t;
+            if (rayHits(p, d, box, &t) && t < best) {
+                best = t;
+            }
+        }
+        if ((hit == BVH_NULL) != (best == FLT_MAX) ||
+            (hit != BVH_NULL && std::fabs(distance - best) > 1e-3F)) {
+            printf("BVH raycast hit at %f, expected %f\n",
+                   hit == BVH_NULL ? -1.0F : distance, best);
+            return false;
+        }
+
+        int closest = bvh.nearest(p, &distance);
+        best = FLT_MAX;
+        for (const Aabb& box : boxes) {
+            best = std::min(best, boxDistance(p, box));
+        }
+        if (closest == BVH_NULL || std::fabs(distance - best) > 1e-3F) {
+            printf("BVH nearest object at %f, expected %f\n", distance,
+                   best);
+            return false;
+        }
+    }
+    return true;
+}
+
+int benchBvh() {
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> coord(-WORLD_SIZE / 2,
+                                                WORLD_SIZE / 2);
+    std::uniform_real_distribution<float> size(0.5F, 5.0F);
+
+    std::vector<float> centers(BVH_OBJECTS * 3);
+    std::vector<float> halves(BVH_OBJECTS);
+    std::vector<Aabb> boxes(BVH_OBJECTS);
+    std::vector<int> proxies(BVH_OBJECTS);
+    Bvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BVH_OBJECTS; ++i) {
+        float* c = &centers[i * 3];
+        c[0] = coord(random);
+        c[1] = coord(random);
+        c[2] = coord(random);
+        halves[i] = size(random);
+        boxes[i] = boxAround(c, halves[i]);
+        proxies[i] = bvh.insert(boxes[i], i);
+    }
+    double buildMs = since(start);
+
+    if (!checkQueries(bvh, boxes, random)) {
+        return 1;
+    }
+
+    // Everything drifts a little, a tenth of the objects a lot
+    std::uniform_real_distribution<float> drift(-0.5F, 0.5F);
+    start = std::chrono::steady_clock::now();
+    int touched = 0;
+    for (int i = 0; i < BVH_OBJECTS; ++i) {
+        float* c = &centers[i * 3];
+        float scale = i % 10 == 0 ? 100.0F : 1.0F;
+        for (int axis = 0; axis < 3; ++axis) {
+            c[axis] += drift(random) * scale;
+        }
+        boxes[i] = boxAround(c, halves[i]);
+        touched += (int)bvh.update(proxies[i], boxes[i]);
+    }
+    double updateMs = since(start);
+
+    if (!checkQueries(bvh, boxes, random)) {
+        printf("BVH queries went wrong after moving the objects\n");
+        return 1;
+    }
+
+    // Timings, brute force frustum culling for scale
+    std::vector<float> points(BVH_QUERIES * 3);
+    for (float& p : points) {
+        p = coord(random);
+    }
+    std::vector<int> found;
+    size_t foundCount = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < BVH_QUERIES; ++q) {
+        found.clear();
+        bvh.queryFrustum(frustumAt(&points[q * 3]), found);
+        foundCount += found.size();
+    }
+    double frustumUs = since(start) * 1000.0 / BVH_QUERIES;
+
+    start = std::chrono::steady_clock::now();
+    size_t bruteCount = 0;
+    for (int q = 0; q < BVH_QUERIES / 10; ++q) {
+        Frustum frustum = frustumAt(&points[q * 3]);
+        for (const Aabb& box : boxes) {
+            bruteCount += (size_t)boxTouches(frustum, box);
+        }
+    }
+    double bruteUs = since(start) * 1000.0 / (BVH_QUERIES / 10);
+
+    const float direction[3] = {0.3F, -0.2F, 0.9F};
+    float distance;
+    int hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < BVH_QUERIES; ++q) {
+        hits += (int)(bvh.raycast(&points[q * 3], direction, FLT_MAX,
+                                  &distance) != BVH_NULL);
+    }
+    double rayUs = since(start) * 1000.0 / BVH_QUERIES;
+
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < BVH_QUERIES; ++q) {
+        bvh.nearest(&points[q * 3], &distance);
+    }
+    double nearestUs = since(start) * 1000.0 / BVH_QUERIES;
+
+    printf("%-12s %d objects, height %d: build %.1f ms, %d of %d moves "
+           "touched the tree in %.1f ms\n",
+           "bvh", bvh.size(), bvh.height(), buildMs, touched, BVH_OBJECTS,
+           updateMs);
+    printf("%-12s frustum %.1f us (%zu objects, brute force %.1f us), "
+           "ray %.2f us (%d hits), nearest %.2f us\n",
+           "bvh", frustumUs, foundCount / BVH_QUERIES, bruteUs, rayUs, hits,
+           nearestUs);
+    return bruteCount > 0 ? 0 : 1;
+}
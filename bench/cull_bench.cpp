@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/culling.h>
+#include <math/mat4.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// The perspective projection of the gears scene at 16:9
+static Mat4 projection() {
+    const float zNear = 1.0F;
+    const float zFar = 1024.0F;
+    const float cotangent = 1.0F / std::tan(30.0F * (float)M_PI / 180.0F);
+    Mat4 m{};
+    m.m[0] = cotangent / (16.0F / 9.0F);
+    m.m[5] = cotangent;
+    m.m[10] = -(zFar + zNear) / (zFar - zNear);
+    m.m[11] = -1.0F;
+    m.m[14] = -2.0F * zNear * zFar / (zFar - zNear);
+    return m;
+}
+
+// The plain test every SIMD lane has to agree with
+static bool referenceVisible(const Frustum& frustum,
+                             float x,
+                             float y,
+                             float z,
+                             float radius) {
+    for (const Vec4& p : frustum.planes) {
+        if (p.x * x + p.y * y + p.z * z + p.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int benchCulling() {
+    Mat4 proj = projection();
+    Frustum frustum = extractFrustum(proj.m);
+
+    // A sphere straight ahead is in, one behind the eye or past the far
+    // plane is out
+    const float probes[4][4] = {{0, 0, -10, 1},
+                                {0, 0, 10, 1},
+                                {0, 0, -2000, 1},
+                                {0, 0, -1024.5F, 1}};
+    const uint8_t expectedProbes[4] = {1, 0, 0, 1};
+    for (int i = 0; i < 4; ++i) {
+        uint8_t in;
+        cullSpheres(frustum, &probes[i][0], &probes[i][1], &probes[i][2],
+                    &probes[i][3], 1, &in);
+        if (in != expectedProbes[i]) {
+            printf("Frustum culling got probe %d wrong\n", i);
+            return 1;
+        }
+    }
+
+    // Objects spread around the eye, most of them outside the view
+    const int count = 100000;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-500.0F, 500.0F);
+    std::uniform_real_distribution<float> size(0.5F, 20.0F);
+    std::vector<float> x(count);
+    std::vector<float> y(count);
+    std::vector<float> z(count);
+    std::vector<float> radius(count);
+    for (int i = 0; i < count; ++i) {
+        x[i] = position(random);
+        y[i] = position(random);
+        z[i] = position(random);
+        radius[i] = size(random);
+    }
+
+    std::vector<uint8_t> visible(count);
+    int visibleCount = cullSpheres(frustum, x.data(), y.data(), z.data(),
+                                   radius.data(), count, visible.data());
+    int expectedCount = 0;
+    for (int i = 0; i < count; ++i) {
+        bool expected = referenceVisible(frustum, x[i], y[i], z[i], radius[i]);
+        expectedCount += (int)expected;
+        if (visible[i] != (uint8_t)expected) {
+            printf("Frustum culling differs from the reference at %d\n", i);
+            return 1;
+        }
+    }
+    if (visibleCount != expectedCount) {
+        printf("Frustum culling counted %d visible, expected %d\n",
+               visibleCount, expectedCount);
+        return 1;
+    }
+
+    const int runs = 50;
+    volatile int sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; ++run) {
+        sink = cullSpheres(frustum, x.data(), y.data(), z.data(),
+                           radius.data(), count, visible.data());
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; ++run) {
+        int n = 0;
+        for (int i = 0; i < count; ++i) {
+            bool in = referenceVisible(frustum, x[i], y[i], z[i], radius[i]);
+            visible[i] = (uint8_t)in;
+            n += (int)in;
+        }
+        sink = n;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double simdMs =
+        std::chrono::duration<double, std::milli>(mid - start).count() / runs;
+    double refMs =
+        std::chrono::duration<double, std::milli>(end - mid).count() / runs;
+    printf("%-12s %d spheres, %d visible: %.3f ms, scalar %.3f ms, %.1fx\n",
+           "culling", count, visibleCount, simdMs, refMs, refMs / simdMs);
+    (void)sink;
+    return 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Longest operation name a baseline line can hold
+#define BENCH_NAME_SIZE 128
+// Extra allocations per operation over the baseline that do not count,
+// rounding noise from the calibration
+#define BENCH_ALLOC_SLACK 0.01
+
+static std::atomic<size_t> allocCount{0};
+static std::atomic<size_t> allocBytes{0};
+
+// Every allocation of the benchmark goes through these, the aligned
+// versions fall back to the plain ones with a larger size
+void* operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    auto alignment = (size_t)align;
+    void* p = aligned_alloc(alignment, (size + alignment - 1) / alignment *
+                                           alignment);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    free(p);
+}
+
+AllocCounts allocCounts() {
+    return {allocCount.load(std::memory_order_relaxed),
+            allocBytes.load(std::memory_order_relaxed)};
+}
+
+static std::vector<BenchResult> results;
+
+void recordResult(const BenchResult& result) {
+    double perSecond = result.itemsPerOp * 1.0e9 / result.nsPerOp;
+    printf("%-24s %11.2f ns/op %10.2f M/s %8.2f allocs/op %10.0f B/op\n",
+           result.name, result.nsPerOp, perSecond / 1.0e6, result.allocsPerOp,
+           result.bytesPerOp);
+    results.push_back(result);
+}
+
+bool saveBaseline(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    for (const BenchResult& result : results) {
+        fprintf(file, "%s %.4f %.4f\n", result.name, result.nsPerOp,
+                result.allocsPerOp);
+    }
+    return fclose(file) == 0;
+}
+
+int compareBaseline(const char* path, double tolerance) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return -1;
+    }
+    // Name to ns/op and allocations/op
+    std::unordered_map<std::string, std::pair<double, double>> baseline;
+    char name[BENCH_NAME_SIZE];
+    double ns;
+    double allocs;
+    while (fscanf(file, "%127s %lf %lf", name, &ns, &allocs) == 3) {
+        baseline[name] = {ns, allocs};
+    }
+    fclose(file);
+
+    printf("\n%-24s %11s %11s %8s\n", "baseline", "before", "after",
+           "change");
+    int regressions = 0;
+    for (const BenchResult& result : results) {
+        auto found = baseline.find(result.name);
+        if (found == baseline.end()) {
+            printf("%-24s %11s %11.2f %8s\n", result.name, "-",
+                   result.nsPerOp, "new");
+            continue;
+        }
+        double before = found->second.first;
+        double change = (result.nsPerOp / before - 1.0) * 100.0;
+        bool slower = change > tolerance;
+        bool allocates =
+            result.allocsPerOp > found->second.second + BENCH_ALLOC_SLACK;
+        printf("%-24s %11.2f %11.2f %+7.1f%%%s%s\n", result.name, before,
+               result.nsPerOp, change, slower ? "  SLOWER" : "",
+               allocates ? "  MORE ALLOCATIONS" : "");
+        regressions += slower || allocates;
+    }
+    return regressions;
+}
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/transform.h>
+#include <jobs/jobs.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define SCALING_ELEMENTS 1000000
+#define SCALING_BATCH_OBJECTS 100000
+#define SCALING_TINY_JOBS 100000
+#define SCALING_ROUNDS 20
+
+static volatile double jobsSink;
+
+template <typename F>
+static double timeMs(F f) {
+    // Warm up the caches and wake the workers
+    f();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SCALING_ROUNDS; ++i) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() /
+           SCALING_ROUNDS;
+}
+
+// Makes sure counters, dependencies and parallelFor do what they promise
+static int checkJobs(JobSystem& jobs) {
+    std::vector<int> hits(SCALING_ELEMENTS, 0);
+    jobs.parallelFor(0, SCALING_ELEMENTS, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            hits[i]++;
+        }
+    });
+    for (int i = 0; i < SCALING_ELEMENTS; ++i) {
+        if (hits[i] != 1) {
+            printf("parallelFor visited %d %d times\n", i, hits[i]);
+            return 1;
+        }
+    }
+
+    // Every stage must see the whole previous stage done
+    std::atomic<int> stage{0};
+    std::atomic<int> errors{0};
+    JobCounter first;
+    JobCounter second;
+    for (int i = 0; i < 64; ++i) {
+        jobs.run([&] { stage.fetch_add(1); }, &first);
+    }
+    for (int i = 0; i < 64; ++i) {
+        jobs.run(
+            [&] {
+                if (stage.load() < 64) {
+                    errors++;
+                }
+            },
+            &second, &first);
+    }
+    jobs.wait(&second);
+    if (errors.load() != 0 || stage.load() != 64) {
+        printf("jobs ran before their dependency finished\n");
+        return 1;
+    }
+    return 0;
+}
+
+int benchJobs() {
+    unsigned cores = std::thread::hardware_concurrency();
+    std::vector<int> threadCounts = {1, 2, 4};
+    if (cores > 4) {
+        threadCounts.push_back((int)cores);
+    }
+
+    std::vector<float> values(SCALING_ELEMENTS);
+    TransformBatch batch;
+    batch.parents.resize(1);
+    batch.parents[0] = Mat4::identity();
+    for (int i = 0; i < SCALING_BATCH_OBJECTS; ++i) {
+        batch.add((float)(i % 100), (float)(i / 100), 0, (float)i * 0.01F);
+    }
+    Mat4 projection = Mat4::identity();
+
+    double base[3] = {0, 0, 0};
+    printf("%-8s %14s %14s %14s\n", "threads", "parallelFor", "batch",
+           "tiny jobs");
+    for (int threads : threadCounts) {
+        JobSystem jobs(threads);
+        if (checkJobs(jobs) != 0) {
+            return 1;
+        }
+
+        double times[3];
+        times[0] = timeMs([&] {
+            jobs.parallelFor(0, SCALING_ELEMENTS, 4096, [&](int b, int e) {
+                for (int i = b; i < e; ++i) {
+                    values[i] = std::sqrt((float)i) * std::sin((float)i);
+                }
+            });
+        });
+        times[1] = timeMs([&] { batch.compute(projection, &jobs); });
+        times[2] = timeMs([&] {
+            JobCounter counter;
+            for (int i = 0; i < SCALING_TINY_JOBS; ++i) {
+                jobs.run([&values, i] { values[i] += 1.0F; }, &counter);
+            }
+            jobs.wait(&counter);
+        });
+
+        if (threads == 1) {
+            for (int i = 0; i < 3; ++i) {
+                base[i] = times[i];
+            }
+        }
+        printf("%-8d", threads);
+        for (int i = 0; i < 3; ++i) {
+            printf(" %7.2fms %4.1fx", times[i], base[i] / times[i]);
+        }
+        printf("\n");
+    }
+    jobsSink = values[SCALING_ELEMENTS / 2] + batch.data()[0].normal.m[0];
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/lod.h>
+#include <math/mat4.h>
+#include <memory/arena.h>
+#include <scene/gears/gearmesh.h>
+#include <cmath>
+#include <cstdio>
+
+// Pixels a tooth has to cover, as in the gears scene
+#define TOOTH_PIXELS 4.0F
+
+int benchLod() {
+    Arena arena;
+    GearMeshCache meshes(&arena);
+    const GearParams shape = {1.0F, 4.0F, 1.0F, 80, 0.7F};
+
+    // Levels of a gear and where they switch
+    LodChain chain = {};
+    int vertices[GEAR_LOD_LEVELS];
+    GearParams lod;
+    int finerTeeth = shape.teeth;
+    while (chain.levelCount < GEAR_LOD_LEVELS &&
+           gearLodParams(shape, chain.levelCount, &lod)) {
+        int level = chain.levelCount++;
+        if (level > 0) {
+            chain.switchSize[level - 1] =
+                TOOTH_PIXELS * (float)finerTeeth / (float)M_PI;
+        }
+        vertices[level] = meshes.get(lod)->nVertices;
+        printf("LOD %d: %3d teeth, %5d vertices", level, lod.teeth,
+               vertices[level]);
+        if (level > 0) {
+            printf(", below %.1f px", chain.switchSize[level - 1]);
+        }
+        printf("\n");
+        finerTeeth = lod.teeth;
+    }
+    if (chain.levelCount < 2) {
+        printf("Gear has no coarser levels\n");
+        return 1;
+    }
+
+    // Levels only get coarser as the gear shrinks on screen
+    int level = 0;
+    for (float size = 1000.0F; size > 1.0F; size *= 0.9F) {
+        int next = selectLod(chain, size, level);
+        if (next < level) {
+            printf("LOD got finer while shrinking at %.1f px\n", size);
+            return 1;
+        }
+        level = next;
+    }
+    if (level != chain.levelCount - 1) {
+        printf("Tiny gear is not at the coarsest level\n");
+        return 1;
+    }
+
+    // A gear wobbling a few percent around a switch size must not pop
+    float edge = chain.switchSize[0];
+    int withHysteresis = 0;
+    int without = 0;
+    level = selectLod(chain, edge * 1.5F, 0);
+    int plain = level;
+    for (int frame = 0; frame < 1000; ++frame) {
+        float size = edge * (1.0F + 0.05F * std::sin((float)frame * 0.3F));
+        int next = selectLod(chain, size, level);
+        withHysteresis += next != level;
+        level = next;
+        int naive = size < edge ? 1 : 0;
+        without += naive != plain;
+        plain = naive;
+    }
+    printf("Around %.1f px over 1000 frames: %d switches, %d without "
+           "hysteresis\n",
+           edge, withHysteresis, without);
+    if (withHysteresis != 0) {
+        return 1;
+    }
+
+    // The scene projection at 1080p, a gear twice as far away every step
+    const float cotangent = 1.0F / std::tan(30.0F * (float)M_PI / 180.0F);
+    Mat4 projection{};
+    projection.m[5] = cotangent;
+    level = 0;
+    for (float depth = 20.0F; depth <= 1024.0F; depth *= 2.0F) {
+        float size = projectedSize(projection, 5.0F, depth, 1080.0F);
+        level = selectLod(chain, size, level);
+        printf("depth %6.0f: %6.1f px, LOD %d, %5d vertices\n", depth, size,
+               level, vertices[level]);
+    }
+    return 0;
+}
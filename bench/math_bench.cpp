@@ -0,0 +1,405 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/transform.h>
+#include <jobs/jobs.h>
+#include <math/mat4.h>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define ITERATIONS 10000000
+#define BATCH_OBJECTS 10000
+#define BATCH_ROUNDS 200
+
+// The scalar matrix routines Graphics used before the SIMD kernels, kept
+// here as the baseline to compare against.
+static void refMul(float* m, const float* n) {
+    float tmp[16];
+    const float* row;
+    const float* column;
+    div_t d;
+
+    for (int i = 0; i < 16; i++) {
+        tmp[i] = 0;
+        d = div(i, 4);
+        row = n + (ptrdiff_t)(d.quot * 4);
+        column = m + d.rem;
+        for (int j = 0; j < 4; j++) {
+            tmp[i] += row[j] * column[(ptrdiff_t)(j * 4)];
+        }
+    }
+    memcpy(m, &tmp, sizeof tmp);
+}
+
+static void refRotate(float* m, float angle, float x, float y, float z) {
+    double s = std::sin((double)angle);
+    double c = std::cos((double)angle);
+    float r[16] = {(float)(x * x * (1 - c) + c),
+                   (float)(y * x * (1 - c) + z * s),
+                   (float)(x * z * (1 - c) - y * s),
+                   0,
+                   (float)(x * y * (1 - c) - z * s),
+                   (float)(y * y * (1 - c) + c),
+                   (float)(y * z * (1 - c) + x * s),
+                   0,
+                   (float)(x * z * (1 - c) + y * s),
+                   (float)(y * z * (1 - c) - x * s),
+                   (float)(z * z * (1 - c) + c),
+                   0,
+                   0,
+                   0,
+                   0,
+                   1};
+    refMul(m, r);
+}
+
+static void refTranslate(float* m, float x, float y, float z) {
+    float t[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1};
+    refMul(m, t);
+}
+
+static void refTranspose(float* m) {
+    float t[16] = {m[0], m[4], m[8],  m[12], m[1], m[5], m[9],  m[13],
+                   m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]};
+    memcpy(m, t, sizeof(t));
+}
+
+static void refInvert(float* m) {
+    float t[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    t[12] = -m[12];
+    t[13] = -m[13];
+    t[14] = -m[14];
+    m[12] = m[13] = m[14] = 0;
+    refTranspose(m);
+    refMul(m, t);
+}
+
+static bool nearlyEqual(const float* a, const float* b, int n) {
+    for (int i = 0; i < n; ++i) {
+        if (std::fabs(a[i] - b[i]) > 1e-4F * (1.0F + std::fabs(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Keeps the optimizer from throwing the benchmarked work away
+static volatile float sink;
+
+template <typename F>
+static double timeNs(F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        f(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               end - start)
+               .count() /
+           ITERATIONS;
+}
+
+static void report(const char* name, double ref, double simd) {
+    printf("%-12s scalar %7.2f ns/op   simd %7.2f ns/op   %5.2fx\n", name,
+           ref, simd, ref / simd);
+}
+
+// Builds the same model view matrix GearsScene::drawGear does
+static void makeModelView(float* m, float angle) {
+    Mat4 r = Mat4::identity();
+    Mat4::translate(r.m, 0, 0, -20);
+    Mat4::rotate(r.m, 0.35F, 1, 0, 0);
+    Mat4::rotate(r.m, 0.52F, 0, 1, 0);
+    Mat4::translate(r.m, -3.0F, -2.0F, 0);
+    Mat4::rotate(r.m, angle, 0, 0, 1);
+    memcpy(m, r.m, sizeof r.m);
+}
+
+static int checkCorrectness() {
+    int failures = 0;
+    alignas(32) float a[16];
+    alignas(32) float b[16];
+    alignas(32) float ref[16];
+    alignas(32) float out[16];
+
+    makeModelView(a, 0.3F);
+    makeModelView(b, 1.7F);
+
+    memcpy(ref, a, sizeof a);
+    refMul(ref, b);
+    Mat4::mul(out, a, b);
+    failures += !nearlyEqual(out, ref, 16);
+
+    memcpy(ref, a, sizeof a);
+    refRotate(ref, 0.8F, 0, 1, 0);
+    memcpy(out, a, sizeof a);
+    Mat4::rotate(out, 0.8F, 0, 1, 0);
+    failures += !nearlyEqual(out, ref, 16);
+
+    memcpy(ref, a, sizeof a);
+    refTranslate(ref, 1, 2, 3);
+    memcpy(out, a, sizeof a);
+    Mat4::translate(out, 1, 2, 3);
+    failures += !nearlyEqual(out, ref, 16);
+
+    memcpy(ref, a, sizeof a);
+    refTranspose(ref);
+    Mat4::transpose(out, a);
+    failures += !nearlyEqual(out, ref, 16);
+
+    memcpy(ref, a, sizeof a);
+    refInvert(ref);
+    Mat4::invertRigid(out, a);
+    failures += !nearlyEqual(out, ref, 16);
+
+    // The general inverse has to agree with the rigid one on rigid input
+    Mat4::invert(out, a);
+    failures += !nearlyEqual(out, ref, 16);
+
+    // And give back the identity for any invertible matrix
+    float scaled[16] = {2, 0.5F, 0, 0, 0, 3, 0.1F, 0, 1, 0, 4, 0, 5, 6, 7, 1};
+    Mat4 s;
+    memcpy(s.m, scaled, sizeof scaled);
+    Mat4 id = s * s.inverse();
+    failures += !nearlyEqual(id.m, Mat4::identity().m, 16);
+
+    return failures;
+}
+
+// Compares the per object matrix chain against TransformBatch on a large
+// scene and makes sure both produce the same matrices.
+static int benchBatch() {
+    alignas(32) float view[16];
+    alignas(32) float proj[16];
+    makeModelView(view, 0.0F);
+    makeModelView(proj, 0.9F);
+    Mat4 projection;
+    memcpy(projection.m, proj, sizeof proj);
+
+    TransformBatch batch;
+    batch.parents.resize(1);
+    memcpy(batch.parents[0].m, view, sizeof view);
+    for (int i = 0; i < BATCH_OBJECTS; ++i) {
+        batch.add((float)(i % 100), (float)(i / 100), 0, (float)i * 0.01F);
+    }
+
+    std::vector<ObjectTransform> ref(BATCH_OBJECTS);
+    auto perObject = [&]() {
+        for (int i = 0; i < BATCH_OBJECTS; ++i) {
+            alignas(32) float mv[16];
+            memcpy(mv, view, sizeof mv);
+            refTranslate(mv, batch.posX[i], batch.posY[i], batch.posZ[i]);
+            refRotate(mv, batch.angle[i], 0, 0, 1);
+            memcpy(ref[i].modelViewProjection.m, proj, sizeof proj);
+            refMul(ref[i].modelViewProjection.m, mv);
+            refInvert(mv);
+            refTranspose(mv);
+            memcpy(ref[i].normal.m, mv, sizeof mv);
+        }
+    };
+
+    perObject();
+    batch.compute(projection);
+    for (int i = 0; i < BATCH_OBJECTS; ++i) {
+        if (!nearlyEqual(batch.data()[i].modelViewProjection.m,
+                         ref[i].modelViewProjection.m, 16) ||
+            !nearlyEqual(batch.data()[i].normal.m, ref[i].normal.m, 16)) {
+            printf("TransformBatch disagrees with the scalar path at %d\n", i);
+            return 1;
+        }
+    }
+
+    auto time = [](auto f) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BATCH_ROUNDS; ++i) {
+            f();
+        }
+        auto end = std::chrono::steady_clock::now();
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   end - start)
+                   .count() /
+               (BATCH_ROUNDS * BATCH_OBJECTS);
+    };
+
+    double scalar = time(perObject);
+    double single = time([&]() { batch.compute(projection); });
+    JobSystem jobs;
+    double threaded = time([&]() { batch.compute(projection, &jobs); });
+    printf("%-12s scalar %7.2f ns/obj   batch %7.2f ns/obj   %5.2fx\n",
+           "batch", scalar, single, scalar / single);
+    printf("%-12s scalar %7.2f ns/obj   batch %7.2f ns/obj   %5.2fx\n",
+           "batch (mt)", scalar, threaded, scalar / threaded);
+    sink = batch.data()[0].normal.m[0] + ref[0].normal.m[0];
+    return 0;
+}
+
+// Runs the suite and saves it as a baseline or compares it with one
+static int runSuite(const char* savePath,
+                    const char* baselinePath,
+                    double tolerance) {
+    benchSuite();
+    if (savePath != nullptr && !saveBaseline(savePath)) {
+        printf("Could not write the baseline to %s\n", savePath);
+        return 1;
+    }
+    if (baselinePath == nullptr) {
+        return 0;
+    }
+    int regressions = compareBaseline(baselinePath, tolerance);
+    if (regressions < 0) {
+        printf("Could not read the baseline from %s\n", baselinePath);
+        return 1;
+    }
+    if (regressions > 0) {
+        printf("%d operation(s) regressed past %.1f%%\n", regressions,
+               tolerance);
+        return 1;
+    }
+    return 0;
+}
+
+// --suite only runs the suite, --save FILE keeps its results as a baseline
+// and --baseline FILE fails the run if any got slower than --tolerance PCT
+int main(int argc, char** argv) {
+    bool suiteOnly = false;
+    const char* savePath = nullptr;
+    const char* baselinePath = nullptr;
+    double tolerance = BENCH_DEFAULT_TOLERANCE;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--suite") == 0) {
+            suiteOnly = true;
+        } else if (strcmp(argv[i], "--save") == 0 && hasValue) {
+            savePath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && hasValue) {
+            tolerance = atof(argv[++i]);
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (suiteOnly) {
+        return runSuite(savePath, baselinePath, tolerance);
+    }
+
+    int failures = checkCorrectness();
+    if (failures != 0) {
+        printf("%d kernel(s) disagree with the scalar reference\n", failures);
+        return 1;
+    }
+
+#if defined(HOMD_SIMD_AVX)
+    printf("Using AVX kernels\n");
+#elif defined(HOMD_SIMD_SSE)
+    printf("Using SSE kernels\n");
+#elif defined(HOMD_SIMD_NEON)
+    printf("Using NEON kernels\n");
+#else
+    printf("Using scalar kernels\n");
+#endif
+
+    alignas(32) float a[16];
+    alignas(32) float b[16];
+    makeModelView(a, 0.3F);
+    makeModelView(b, 1.7F);
+    alignas(32) float m[16];
+
+    double ref;
+    double simd;
+
+    memcpy(m, a, sizeof a);
+    ref = timeNs([&](int) { refMul(m, b); });
+    sink = m[0];
+    memcpy(m, a, sizeof a);
+    simd = timeNs([&](int) { Mat4::mul(m, m, b); });
+    sink = m[0];
+    report("mul", ref, simd);
+
+    memcpy(m, a, sizeof a);
+    ref = timeNs([&](int i) { refRotate(m, (float)(i & 7), 0, 0, 1); });
+    sink = m[0];
+    memcpy(m, a, sizeof a);
+    simd = timeNs([&](int i) { Mat4::rotate(m, (float)(i & 7), 0, 0, 1); });
+    sink = m[0];
+    report("rotate", ref, simd);
+
+    memcpy(m, a, sizeof a);
+    ref = timeNs([&](int) { refTranslate(m, 0.1F, 0.2F, 0.3F); });
+    sink = m[0];
+    memcpy(m, a, sizeof a);
+    simd = timeNs([&](int) { Mat4::translate(m, 0.1F, 0.2F, 0.3F); });
+    sink = m[0];
+    report("translate", ref, simd);
+
+    memcpy(m, a, sizeof a);
+    ref = timeNs([&](int) { refTranspose(m); });
+    sink = m[0];
+    memcpy(m, a, sizeof a);
+    simd = timeNs([&](int) { Mat4::transpose(m, m); });
+    sink = m[0];
+    report("transpose", ref, simd);
+
+    memcpy(m, a, sizeof a);
+    ref = timeNs([&](int) { refInvert(m); });
+    sink = m[0];
+    memcpy(m, a, sizeof a);
+    simd = timeNs([&](int) { Mat4::invertRigid(m, m); });
+    sink = m[0];
+    report("invertRigid", ref, simd);
+
+    // The whole matrix chain drawGear runs for every gear
+    auto refChain = [&](int i) {
+        float mv[16];
+        float mvp[16];
+        memcpy(mv, a, sizeof mv);
+        refTranslate(mv, 3.1F, -2.0F, 0);
+        refRotate(mv, (float)(i & 7), 0, 0, 1);
+        memcpy(mvp, b, sizeof mvp);
+        refMul(mvp, mv);
+        refInvert(mv);
+        refTranspose(mv);
+        sink = mvp[0] + mv[0];
+    };
+    auto simdChain = [&](int i) {
+        alignas(32) float mv[16];
+        alignas(32) float mvp[16];
+        memcpy(mv, a, sizeof mv);
+        Mat4::translate(mv, 3.1F, -2.0F, 0);
+        Mat4::rotate(mv, (float)(i & 7), 0, 0, 1);
+        Mat4::mul(mvp, b, mv);
+        Mat4::invertRigid(mv, mv);
+        Mat4::transpose(mv, mv);
+        sink = mvp[0] + mv[0];
+    };
+    report("drawGear", timeNs(refChain), timeNs(simdChain));
+
+    if (benchBatch() != 0 || benchVertexFormats() != 0 ||
+        benchMeshOptimizer() != 0 || benchSortKeys() != 0 ||
+        benchCulling() != 0 || benchBvh() != 0 || benchLod() != 0 ||
+        benchJobs() != 0) {
+        return 1;
+    }
+    return runSuite(savePath, baselinePath, tolerance);
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/radixsort.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Times a sort of the same items over several runs, in milliseconds
+template <typename F>
+static double timeSort(const std::vector<SortItem>& input, F&& sort) {
+    const int runs = 20;
+    std::vector<SortItem> items;
+    double total = 0;
+    for (int run = 0; run < runs; ++run) {
+        items = input;
+        auto start = std::chrono::steady_clock::now();
+        sort(items);
+        auto end = std::chrono::steady_clock::now();
+        total += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    return total / runs;
+}
+
+int benchSortKeys() {
+    std::mt19937_64 random(42);
+    const size_t counts[3] = {48, 4096, 100000};
+    for (size_t count : counts) {
+        // Keys shaped like the ones of the render queue, a few programs,
+        // materials and vertex arrays with the depth all over the place
+        std::vector<SortItem> input(count);
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t program = random() % 8;
+            uint64_t material = random() % 64;
+            uint64_t vertexArray = random() % 256;
+            uint64_t depth = random() & 0xFFFF;
+            input[i].key = program << 48 | material << 32 |
+                           vertexArray << 16 | depth;
+            input[i].index = (uint32_t)i;
+        }
+
+        auto byKey = [](const SortItem& a, const SortItem& b) {
+            return a.key < b.key;
+        };
+        std::vector<SortItem> expected = input;
+        std::stable_sort(expected.begin(), expected.end(), byKey);
+        std::vector<SortItem> scratch(count);
+        std::vector<SortItem> sorted = input;
+        radixSort(sorted.data(), scratch.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            if (sorted[i].key != expected[i].key ||
+                sorted[i].index != expected[i].index) {
+                printf("Radix sort differs from std::stable_sort at %zu\n",
+                       i);
+                return 1;
+            }
+        }
+
+        double radixMs = timeSort(input, [&](std::vector<SortItem>& items) {
+            radixSort(items.data(), scratch.data(), items.size());
+        });
+        double stdMs = timeSort(input, [&](std::vector<SortItem>& items) {
+            std::stable_sort(items.begin(), items.end(), byKey);
+        });
+        printf("%-12s %6zu keys: radix %.3f ms, std::stable_sort %.3f ms, "
+               "%.1fx\n",
+               "sort keys", count, radixMs, stdMs, stdMs / radixMs);
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/culling.h>
+#include <graphics/transform.h>
+#include <math/mat4.h>
+#include <memory/arena.h>
+#include <profile/profiler.h>
+#include <scene/gears/gearmesh.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Objects in the culling and transform runs
+#define SUITE_OBJECTS 10000
+
+// Keeps the optimizer from throwing the benchmarked work away
+static volatile float sink;
+
+// Gear shapes createGear is timed at, the first is the large gear of the
+// scene at several tooth counts
+static const struct {
+    const char* name;
+    int teeth;
+} gearSizes[] = {
+    {"gear/build/10", 10},
+    {"gear/build/20", 20},
+    {"gear/build/80", 80},
+    {"gear/build/320", 320},
+};
+
+/**
+ * Does the CPU side of GearsScene::createGear, everything up to the
+ * buffer uploads.
+ *
+ * @param teeth the number of teeth
+ *
+ * @return the number of vertices of the optimized mesh
+ */
+static int buildGear(int teeth) {
+    Arena arena;
+    GearMeshCache meshes(&arena);
+    const GearParams params = {1.0F, 4.0F, 1.0F, teeth, 0.7F};
+    const GearMesh* mesh = meshes.get(params);
+    Bounds bounds =
+        computeBounds(mesh->vertices, mesh->nVertices, sizeof(GearVertex));
+
+    const OptimizedGearMesh* optimized = meshes.getOptimized(params);
+    sink = bounds.radius;
+    return optimized->nVertices;
+}
+
+int benchSuite() {
+    // The matrix helpers of Graphics are thin wrappers over the Mat4
+    // functions timed here
+    alignas(32) float a[16];
+    alignas(32) float b[16];
+    memcpy(a, Mat4::identity().m, sizeof a);
+    Mat4::translate(a, 0, 0, -20);
+    Mat4::rotate(a, 0.35F, 1, 0, 0);
+    memcpy(b, Mat4::identity().m, sizeof b);
+    Mat4::rotate(b, 0.52F, 0, 1, 0);
+    alignas(32) float m[16];
+
+    // Every run keeps reusing m, so none may let it grow: mul and rotate
+    // only chain rotations onto it and translate steps back and forth
+    memcpy(m, a, sizeof a);
+    measure("mat4/mul", 1, [&](int) { Mat4::mul(m, m, b); });
+    memcpy(m, a, sizeof a);
+    measure("mat4/rotate", 1,
+            [&](int i) { Mat4::rotate(m, (float)(i & 7), 0, 0, 1); });
+    memcpy(m, a, sizeof a);
+    measure("mat4/translate", 1, [&](int i) {
+        float step = (i & 1) != 0 ? -1.0F : 1.0F;
+        Mat4::translate(m, 0.1F * step, 0.2F * step, 0.3F * step);
+    });
+    memcpy(m, a, sizeof a);
+    measure("mat4/invertRigid", 1, [&](int) { Mat4::invertRigid(m, m); });
+    memcpy(m, a, sizeof a);
+    measure("mat4/invert", 1, [&](int) { Mat4::invert(m, m); });
+    measure("mat4/perspective", 1, [&](int i) {
+        Mat4::perspective(m, 60.0F, 1.0F + (float)(i & 7), 1.0F, 1024.0F);
+    });
+    sink = m[0];
+
+    for (const auto& size : gearSizes) {
+        int teeth = size.teeth;
+        measure(size.name, teeth, [teeth](int) { buildGear(teeth); });
+    }
+
+    // A field of gears in front of the camera, some of them out of view
+    Mat4 projection;
+    Mat4::perspective(projection.m, 60.0F, 16.0F / 9.0F, 1.0F, 1024.0F);
+    TransformBatch batch;
+    batch.parents.resize(1);
+    batch.parents[0] = Mat4::identity();
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> spread(-200.0F, 200.0F);
+    std::uniform_real_distribution<float> depth(-900.0F, 50.0F);
+    for (int i = 0; i < SUITE_OBJECTS; ++i) {
+        int index = batch.add(spread(random), spread(random), depth(random),
+                              (float)i * 0.01F);
+        batch.radius[index] = 5.0F;
+    }
+
+    measure("transform/compute", SUITE_OBJECTS,
+            [&](int) { batch.compute(projection); });
+    measure("cull/batch", SUITE_OBJECTS,
+            [&](int) { sink = (float)batch.cull(projection); });
+
+    Frustum frustum = extractFrustum(projection.m);
+    std::vector<uint8_t> visible(SUITE_OBJECTS);
+    measure("cull/spheres", SUITE_OBJECTS, [&](int) {
+        sink = (float)cullSpheres(frustum, batch.posX.data(),
+                                  batch.posY.data(), batch.posZ.data(),
+                                  batch.radius.data(), SUITE_OBJECTS,
+                                  visible.data());
+    });
+
+#ifdef HOMD_PROFILE
+    // What every zone adds to the scope it measures
+    measure("profile/zone", 1, [](int) { PROFILE_ZONE("Bench"); });
+#endif
+    return 0;
+}
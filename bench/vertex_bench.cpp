@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include <graphics/meshopt.h>
+#include <graphics/vertex.h>
+#include <memory/arena.h>
+#include <scene/gears/gearmesh.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Largest position error allowed, half a pixel at 1080p for a gear in the
+// default camera of the gears scene
+#define MAX_POSITION_ERROR 0.01
+// Largest change in diffuse lighting allowed, one step of an 8 bit channel
+#define MAX_LIGHTING_ERROR (1.0 / 255.0)
+// Light directions the lighting is compared under
+#define LIGHT_DIRECTIONS 64
+
+// Unit vector of the length of v
+static void normalize(float v[3]) {
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (int i = 0; i < 3; ++i) {
+        v[i] /= length;
+    }
+}
+
+// The lighting term of the gears shaders
+static float diffuse(const float n[3], const float l[3]) {
+    float d = n[0] * l[0] + n[1] * l[1] + n[2] * l[2];
+    return d > 0.0F ? d : 0.0F;
+}
+
+/**
+ * Checks that a packed mesh shades and rasterizes like the float one.
+ *
+ * @param mesh the mesh to check
+ * @param[out] positionError the largest position error found
+ * @param[out] lightingError the largest diffuse lighting error found
+ */
+static void compareMesh(const GearMesh* mesh,
+                        double& positionError,
+                        double& lightingError) {
+    std::vector<PackedGearVertex> packed(mesh->nVertices);
+    packGearVertices(mesh->vertices, mesh->nVertices, packed.data());
+
+    // Directions spread over the sphere
+    float lights[LIGHT_DIRECTIONS][3];
+    for (int i = 0; i < LIGHT_DIRECTIONS; ++i) {
+        float z = 1.0F - 2.0F * ((float)i + 0.5F) / LIGHT_DIRECTIONS;
+        float r = std::sqrt(1.0F - z * z);
+        float phi = (float)i * 2.39996323F;
+        lights[i][0] = r * std::cos(phi);
+        lights[i][1] = r * std::sin(phi);
+        lights[i][2] = z;
+    }
+
+    for (int v = 0; v < mesh->nVertices; ++v) {
+        const GLfloat* ref = mesh->vertices[v];
+        for (int i = 0; i < 3; ++i) {
+            double error =
+                std::fabs(unpackHalf(packed[v].position[i]) - ref[i]);
+            positionError = error > positionError ? error : positionError;
+        }
+
+        float n[3] = {ref[3], ref[4], ref[5]};
+        float p[3];
+        normalize(n);
+        unpackNormal(packed[v].normal, p);
+        normalize(p);
+        for (const auto& light : lights) {
+            double error = std::fabs(diffuse(n, light) - diffuse(p, light));
+            lightingError = error > lightingError ? error : lightingError;
+        }
+    }
+}
+
+int benchVertexFormats() {
+    Arena arena;
+    GearMeshCache meshes(&arena);
+    const GearParams shapes[] = {
+        {1.0F, 4.0F, 1.0F, 20, 0.7F},
+        {0.5F, 2.0F, 2.0F, 10, 0.7F},
+        {1.3F, 2.0F, 0.5F, 10, 0.7F},
+        {3.0F, 12.0F, 2.0F, 400, 0.5F},
+    };
+
+    double positionError = 0.0;
+    double lightingError = 0.0;
+    int vertices = 0;
+    for (const auto& shape : shapes) {
+        const GearMesh* mesh = meshes.get(shape);
+        compareMesh(mesh, positionError, lightingError);
+        vertices += mesh->nVertices;
+    }
+    if (positionError > MAX_POSITION_ERROR ||
+        lightingError > MAX_LIGHTING_ERROR) {
+        printf("Packed gear vertices differ visibly: position %g, "
+               "lighting %g\n",
+               positionError, lightingError);
+        return 1;
+    }
+
+    // Packing cost on the largest mesh
+    const GearMesh* large = meshes.get(shapes[3]);
+    std::vector<PackedGearVertex> packed(large->nVertices);
+    auto start = std::chrono::steady_clock::now();
+    packGearVertices(large->vertices, large->nVertices, packed.data());
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    printf("%-12s float %zu B/vertex   packed %zu B/vertex   %4.1f%% smaller\n",
+           "vertex", sizeof(GearVertex), sizeof(PackedGearVertex),
+           100.0 * (1.0 - (double)sizeof(PackedGearVertex) /
+                              (double)sizeof(GearVertex)));
+    printf("%-12s %d vertices, max position error %.5f, max lighting "
+           "error %.5f, %.2f ns/vertex to pack\n",
+           "vertex", vertices, positionError, lightingError,
+           ns / large->nVertices);
+    return 0;
+}
+
+// Triangles of a mesh as vertex contents, each starting at its smallest
+// vertex so equal triangles compare equal whatever the index order
+static std::vector<std::array<float, 18>> triangleSet(
+    const GLfloat* vertices,
+    const std::vector<GLuint>& indices) {
+    std::vector<std::array<float, 18>> triangles;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const GLfloat* v[3];
+        for (int k = 0; k < 3; ++k) {
+            v[k] = vertices + (size_t)indices[t + k] * GEAR_VERTEX_STRIDE;
+        }
+        int first = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (memcmp(v[k], v[first], sizeof(GearVertex)) < 0) {
+                first = k;
+            }
+        }
+
+        std::array<float, 18> triangle;
+        for (int k = 0; k < 3; ++k) {
+            memcpy(&triangle[k * 6], v[(first + k) % 3], sizeof(GearVertex));
+        }
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+int benchMeshOptimizer() {
+    Arena arena;
+    GearMeshCache meshes(&arena);
+    const GearParams shapes[] = {
+        {1.0F, 4.0F, 1.0F, 20, 0.7F},
+        {3.0F, 12.0F, 2.0F, 400, 0.5F},
+    };
+
+    for (const auto& shape : shapes) {
+        const GearMesh* mesh = meshes.get(shape);
+        OptimizedMesh optimized;
+        auto start = std::chrono::steady_clock::now();
+        optimizeStripMesh(mesh->vertices, mesh->nVertices, sizeof(GearVertex),
+                          mesh->strips, mesh->nStrips, optimized);
+        auto end = std::chrono::steady_clock::now();
+        double ms =
+            std::chrono::duration<double, std::milli>(end - start).count();
+
+        // The optimized mesh must draw exactly the same triangles
+        std::vector<GLuint> original;
+        stripsToTriangles(mesh->strips, mesh->nStrips, original);
+        if (triangleSet((const GLfloat*)mesh->vertices, original) !=
+            triangleSet((const GLfloat*)optimized.vertices.data(),
+                        optimized.indices)) {
+            printf("Optimized gear mesh does not match the strips\n");
+            return 1;
+        }
+
+        // The cache optimizes a shape once and hands out the same mesh
+        const OptimizedGearMesh* cached = meshes.getOptimized(shape);
+        std::vector<GLuint> cachedIndices(cached->indices,
+                                          cached->indices + cached->nIndices);
+        if (cached != meshes.getOptimized(shape) ||
+            triangleSet((const GLfloat*)cached->vertices, cachedIndices) !=
+                triangleSet((const GLfloat*)mesh->vertices, original)) {
+            printf("Cached gear mesh does not match the strips\n");
+            return 1;
+        }
+
+        printf("%-12s %d teeth: %d -> %d vertices, ACMR %.3f -> %.3f, "
+               "%.2f ms\n",
+               "meshopt", shape.teeth, mesh->nVertices, optimized.nVertices,
+               optimized.acmrBefore, optimized.acmrAfter, ms);
+    }
+    return 0;
+}
@@ -16,20 +16,267 @@
  */
 
 #include <game/game.h>
+#include <game/report.h>
 #include <graphics/graphics.h>
+#include <jobs/jobs.h>
+#include <profile/profiler.h>
 #include <scene/gears/gears.h>
+#include <cstdio>
+#include <vector>
 
-Game::Game() {
+// SDL_Delay is only trusted for waits longer than this, in seconds
+#define SPIN_THRESHOLD 0.002
+
+Game::Game(const HeadlessConfig* config) {
+    if (config != nullptr) {
+        this->headless = *config;
+    }
     this->pWindow = new Window(this);
     this->pRenderer = new Graphics(this);
     this->pInput = new Input(this);
+    this->pJobs = new JobSystem;
+    this->frequency = SDL_GetPerformanceFrequency();
+    this->setPacing(this->pacing, this->frameCap);
     this->scenes.push(new GearsScene(this));
 }
 
+Game::~Game() {
+    if (this->pipelined) {
+        this->waitUpdates();
+        this->stopWorker();
+    }
+    while (!this->scenes.empty()) {
+        delete this->scenes.top();
+        this->scenes.pop();
+    }
+    delete this->pJobs;
+    delete this->pRenderer;
+    delete this->pInput;
+    delete this->pWindow;
+}
+
+bool Game::isHeadless() const {
+    return this->headless.frames > 0;
+}
+
+const HeadlessConfig& Game::getHeadlessConfig() const {
+    return this->headless;
+}
+
+void Game::setPacing(FramePacing mode, int cap) {
+    this->pacing = mode;
+    this->frameCap = cap > 0 ? cap : DEFAULT_FRAME_CAP;
+
+    // Try adaptive vsync first, so a late frame tears instead of waiting
+    // for the next refresh
+    if (mode == FramePacing::VSync && SDL_GL_SetSwapInterval(-1) != 0 &&
+        SDL_GL_SetSwapInterval(1) != 0) {
+        this->pacing = FramePacing::Adaptive;
+    }
+    if (this->pacing != FramePacing::VSync) {
+        SDL_GL_SetSwapInterval(0);
+    }
+}
+
+void Game::pace(Uint64 frameStart) {
+    if (this->pacing == FramePacing::Uncapped ||
+        this->pacing == FramePacing::VSync) {
+        return;
+    }
+    PROFILE_ZONE("Game::pace");
+
+    Uint64 frameEnd = frameStart + this->frequency / this->frameCap;
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now >= frameEnd) {
+        return;
+    }
+
+    if (this->pacing == FramePacing::Cap) {
+        auto spin = (Uint64)(SPIN_THRESHOLD * (double)this->frequency);
+        if (frameEnd - now > spin) {
+            SDL_Delay((Uint32)((frameEnd - now - spin) * 1000 /
+                               this->frequency));
+        }
+        while (SDL_GetPerformanceCounter() < frameEnd) {
+        }
+        return;
+    }
+
+    // Adaptive, wake up early by the usual oversleep and let the next
+    // frame absorb whatever is left
+    Uint64 remaining = frameEnd - now;
+    if (remaining <= this->oversleep) {
+        return;
+    }
+    Uint64 wait = remaining - this->oversleep;
+    auto ms = (Uint32)(wait * 1000 / this->frequency);
+    if (ms == 0) {
+        return;
+    }
+    SDL_Delay(ms);
+
+    Uint64 slept = SDL_GetPerformanceCounter() - now;
+    Uint64 asked = (Uint64)ms * this->frequency / 1000;
+    Uint64 late = slept > asked ? slept - asked : 0;
+    // Smooth the estimate over a few frames
+    this->oversleep = (this->oversleep * 7 + late) / 8;
+}
+
+void Game::setPipelined(bool enable) {
+    // Headless runs never go through the loop that feeds and stops the
+    // worker
+    if (this->isHeadless()) {
+        return;
+    }
+    if (enable && !this->pipelined) {
+        this->quitWorker = false;
+        this->worker = std::thread(&Game::workerLoop, this);
+    } else if (!enable && this->pipelined) {
+        this->stopWorker();
+    }
+    this->pipelined = enable;
+}
+
+void Game::workerLoop() {
+    PROFILE_THREAD("Update worker");
+    std::unique_lock<std::mutex> lock(this->workMutex);
+    while (true) {
+        this->workCond.wait(
+            lock, [this] { return this->working || this->quitWorker; });
+        if (this->quitWorker) {
+            return;
+        }
+
+        // The main thread does not touch the scene until working is reset
+        lock.unlock();
+        {
+            PROFILE_ZONE("Scene::update");
+            const double step = 1.0 / SIMULATION_RATE;
+            for (int i = 0; i < this->workSteps; ++i) {
+                this->workScene->update(step);
+            }
+        }
+        lock.lock();
+
+        this->working = false;
+        this->workCond.notify_all();
+    }
+}
+
+void Game::startUpdates(Scene* scene, int steps) {
+    std::lock_guard<std::mutex> lock(this->workMutex);
+    this->workScene = scene;
+    this->workSteps = steps;
+    this->working = true;
+    this->workCond.notify_all();
+}
+
+void Game::waitUpdates() {
+    std::unique_lock<std::mutex> lock(this->workMutex);
+    this->workCond.wait(lock, [this] { return !this->working; });
+}
+
+void Game::stopWorker() {
+    {
+        std::lock_guard<std::mutex> lock(this->workMutex);
+        this->quitWorker = true;
+        this->workCond.notify_all();
+    }
+    this->worker.join();
+}
+
+void Game::runHeadless() {
+    const double step = 1.0 / SIMULATION_RATE;
+    // Every frame simulates the same time, so runs only differ in how
+    // long the work takes
+    const int steps = SIMULATION_RATE / HEADLESS_FRAME_RATE;
+    FrameReport report;
+    report.reserve(this->headless.frames);
+    std::vector<GpuFrameTime> gpuFrames;
+    PROFILE_THREAD("Main");
+
+    for (int frame = 0; frame < this->headless.frames; ++frame) {
+        if (this->scenes.empty()) {
+            break;
+        }
+        Scene* scene = this->scenes.top();
+        if (scene->destroy) {
+            delete scene;
+            this->scenes.pop();
+            continue;
+        }
+
+        PROFILE_ZONE("Frame");
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        this->pWindow->updateDimensions();
+        {
+            PROFILE_ZONE("Scene::update");
+            for (int i = 0; i < steps; ++i) {
+                scene->update(step);
+            }
+        }
+        scene->publish();
+        this->pRenderer->beginFrame();
+        scene->render(0.0);
+        Uint64 frameEnd = SDL_GetPerformanceCounter();
+
+        // The GPU time comes in a few frames later
+        FrameRecord record;
+        record.cpuMs =
+            (double)(frameEnd - frameStart) * 1000.0 / (double)this->frequency;
+        record.gpuMs = -1.0;
+        record.stats = Graphics::lastFrameStats;
+        report.add(record);
+        this->pRenderer->gpuTimer.takeFinished(gpuFrames);
+        for (const GpuFrameTime& gpuFrame : gpuFrames) {
+            report.setGpuTime(gpuFrame.frame, gpuFrame.ms);
+        }
+    }
+
+    // Waiting is fine once the run is over
+    this->pRenderer->gpuTimer.flush();
+    this->pRenderer->gpuTimer.takeFinished(gpuFrames);
+    for (const GpuFrameTime& gpuFrame : gpuFrames) {
+        report.setGpuTime(gpuFrame.frame, gpuFrame.ms);
+    }
+
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    if (!report.write(this->headless.output, renderer, this->headless.width,
+                      this->headless.height)) {
+        fprintf(stderr, "Could not write the report to %s\n",
+                this->headless.output);
+    }
+}
+
 void Game::loop() {
+    if (this->isHeadless()) {
+        this->runHeadless();
+        return;
+    }
+
+    const double step = 1.0 / SIMULATION_RATE;
+    double accumulator = 0.0;
+    // Interpolation factor of the updates behind the current packet
+    double alpha = 0.0;
+    Uint64 previous = SDL_GetPerformanceCounter();
+    PROFILE_THREAD("Main");
+
     while (!this->done && !this->scenes.empty()) {
+        PROFILE_ZONE("Frame");
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        double elapsed =
+            (double)(frameStart - previous) / (double)this->frequency;
+        previous = frameStart;
+        accumulator += elapsed < MAX_FRAME_TIME ? elapsed : MAX_FRAME_TIME;
+
         this->pWindow->updateDimensions();
         this->done = this->pInput->pollEvent();
+
+        // Everything below up to startUpdates runs with the worker idle
+        if (this->pipelined) {
+            PROFILE_ZONE("Game::waitUpdates");
+            this->waitUpdates();
+        }
         this->pInput->pollKeys();
 
         if (this->scenes.top()->destroy) {
@@ -38,6 +285,38 @@ void Game::loop() {
             continue;
         }
 
-        this->scenes.top()->draw();
+        Scene* scene = this->scenes.top();
+        int steps = (int)(accumulator / step);
+        accumulator -= steps * step;
+
+        if (this->pipelined) {
+            // Show what the previous frame's updates produced while the
+            // worker computes the next ones
+            scene->publish();
+            double packetAlpha = alpha;
+            alpha = accumulator / step;
+            this->startUpdates(scene, steps);
+            this->pRenderer->beginFrame();
+            scene->render(packetAlpha);
+        } else {
+            {
+                PROFILE_ZONE("Scene::update");
+                for (int i = 0; i < steps; ++i) {
+                    scene->update(step);
+                }
+            }
+            scene->publish();
+            alpha = accumulator / step;
+            this->pRenderer->beginFrame();
+            scene->render(alpha);
+        }
+
+        this->pace(frameStart);
+    }
+
+    if (this->pipelined) {
+        this->waitUpdates();
+        this->stopWorker();
+        this->pipelined = false;
     }
-}
\ No newline at end of file
+}
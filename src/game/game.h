@@ -20,22 +20,143 @@
 
 #include <window/window.h>
 #include <input/input.h>
+#include <condition_variable>
+#include <mutex>
 #include <stack>
+#include <thread>
+
+// Simulation steps per second, every scene update advances 1 / this
+#define SIMULATION_RATE 120
+// Longest frame the simulation catches up on, anything above is dropped
+// so a stall does not turn into a burst of updates
+#define MAX_FRAME_TIME 0.25
+#define DEFAULT_FRAME_CAP 60
+// Frames per simulated second of a headless run
+#define HEADLESS_FRAME_RATE 60
 
 class Scene;
 class Graphics;
+class JobSystem;
+
+// Settings of a run without a window, drawing into an offscreen target
+// with a fixed simulated time per frame
+using HeadlessConfig = struct HeadlessConfig {
+    // Number of frames to draw before quitting, 0 for a windowed run
+    int frames;
+    // Size of the render target
+    int width;
+    int height;
+    // Where to write the JSON report, nullptr for stdout
+    const char* output;
+};
+
+// How the loop waits between rendered frames
+enum class FramePacing {
+    // Render as fast as possible
+    Uncapped,
+    // Sync buffer swaps to the display
+    VSync,
+    // Sleep most of the spare time and spin the rest, precise but costs
+    // a little CPU
+    Cap,
+    // Only sleep, correcting for how much the OS tends to oversleep
+    Adaptive,
+};
 
 class Game {
     bool done = false;
     std::stack<Scene*> scenes;
+    FramePacing pacing = FramePacing::Adaptive;
+    int frameCap = DEFAULT_FRAME_CAP;
+    // Ticks of the performance counter per second
+    Uint64 frequency;
+    // Running estimate of how late SDL_Delay wakes up, in counter ticks
+    Uint64 oversleep = 0;
+
+    // Whether scene updates run on the worker while the frame renders
+    bool pipelined = false;
+    std::thread worker;
+    std::mutex workMutex;
+    std::condition_variable workCond;
+    // The job handed to the worker, guarded by workMutex
+    Scene* workScene = nullptr;
+    int workSteps = 0;
+    bool working = false;
+    bool quitWorker = false;
+
+    // The headless run, if this is one
+    HeadlessConfig headless = {};
+
+    // Runs the update jobs handed over by the main thread
+    void workerLoop();
+
+    /**
+     * Hands updates over to the worker.
+     *
+     * @param scene the scene to update
+     * @param steps the number of fixed steps to run
+     */
+    void startUpdates(Scene* scene, int steps);
+
+    // Blocks until the worker is done with its updates
+    void waitUpdates();
+
+    // Stops and joins the worker
+    void stopWorker();
+
+    /**
+     * Waits out the rest of the frame as the pacing mode asks.
+     *
+     * @param frameStart the performance counter at the start of the frame
+     */
+    void pace(Uint64 frameStart);
+
+    // Draws the frames of a headless run and writes the report
+    void runHeadless();
 
    public:
     Window* pWindow;
     Input* pInput;
     Graphics* pRenderer;
+    // Runs engine tasks across all cores
+    JobSystem* pJobs;
+
+    /**
+     * Sets up the window, the renderer and the first scene.
+     *
+     * @param config the settings of a headless run, nullptr to open a
+     * window
+     */
+    explicit Game(const HeadlessConfig* config = nullptr);
+    // Stops the worker and tears everything down, scenes first and the
+    // window last so the context outlives every GL object
+    ~Game();
+    Game(const Game&) = delete;
+    Game& operator=(const Game&) = delete;
+
+    // Whether the game draws offscreen without a window
+    [[nodiscard]] bool isHeadless() const;
+
+    // Settings of the headless run
+    [[nodiscard]] const HeadlessConfig& getHeadlessConfig() const;
+
+    /**
+     * Selects how rendered frames are paced.
+     *
+     * @param mode the pacing mode
+     * @param cap the frame rate limit of the Cap and Adaptive modes
+     */
+    void setPacing(FramePacing mode, int cap = DEFAULT_FRAME_CAP);
 
-    Game();
-    ~Game() = default;
+    /**
+     * Selects whether scene updates for the next frame run on a worker
+     * thread while the main thread renders the current one. Frames are
+     * shown one frame later in exchange. Headless runs are never
+     * pipelined.
+     *
+     * @param enable whether to pipeline
+     */
+    void setPipelined(bool enable);
 
     void loop();
 };
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <game/game.h>
+#include <game/report.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+void FrameTimes::add(double ms) {
+    this->times.push_back(ms);
+}
+
+void FrameTimes::clear() {
+    this->times.clear();
+}
+
+size_t FrameTimes::size() const {
+    return this->times.size();
+}
+
+double FrameTimes::percentile(double p) const {
+    if (this->times.empty()) {
+        return 0.0;
+    }
+    this->sorted = this->times;
+    auto rank = (size_t)std::ceil(p / 100.0 * (double)this->sorted.size());
+    size_t index = rank > 0 ? rank - 1 : 0;
+    index = index < this->sorted.size() ? index : this->sorted.size() - 1;
+    std::nth_element(this->sorted.begin(), this->sorted.begin() + index,
+                     this->sorted.end());
+    return this->sorted[index];
+}
+
+/**
+ * Writes the mean, the extremes and the percentiles of a frame time.
+ *
+ * @param file the file to write to
+ * @param name the key of the summary
+ * @param frames the frames to summarize
+ * @param gpu whether to summarize the GPU time instead of the CPU time
+ */
+static void writeSummary(FILE* file,
+                         const char* name,
+                         const std::vector<FrameRecord>& frames,
+                         bool gpu) {
+    FrameTimes times;
+    double sum = 0.0;
+    for (const FrameRecord& frame : frames) {
+        double ms = gpu ? frame.gpuMs : frame.cpuMs;
+        if (ms >= 0.0) {
+            times.add(ms);
+            sum += ms;
+        }
+    }
+    if (times.size() == 0) {
+        fprintf(file, "  \"%s\": null,\n", name);
+        return;
+    }
+    fprintf(file,
+            "  \"%s\": {\"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, "
+            "\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f},\n",
+            name, sum / (double)times.size(), times.percentile(0.0),
+            times.percentile(100.0), times.percentile(50.0),
+            times.percentile(95.0), times.percentile(99.0));
+}
+
+void FrameReport::reserve(int count) {
+    this->frames.reserve(count);
+}
+
+void FrameReport::add(const FrameRecord& record) {
+    this->frames.push_back(record);
+}
+
+void FrameReport::setGpuTime(size_t frame, double ms) {
+    if (frame < this->frames.size()) {
+        this->frames[frame].gpuMs = ms;
+    }
+}
+
+bool FrameReport::write(const char* path,
+                        const char* renderer,
+                        int width,
+                        int height) const {
+    FILE* file = path != nullptr ? fopen(path, "w") : stdout;
+    if (file == nullptr) {
+        return false;
+    }
+
+    // The renderer string is the only text that comes from outside
+    fprintf(file, "{\n  \"renderer\": \"");
+    for (const char* c = renderer; c != nullptr && *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*c >= 0x20) {
+            fputc(*c, file);
+        }
+    }
+    fprintf(file, "\",\n");
+    fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n", width, height);
+    fprintf(file, "  \"frameRate\": %d,\n  \"simulationRate\": %d,\n",
+            HEADLESS_FRAME_RATE, SIMULATION_RATE);
+    fprintf(file, "  \"frameCount\": %zu,\n", this->frames.size());
+    writeSummary(file, "cpuMs", this->frames, false);
+    writeSummary(file, "gpuMs", this->frames, true);
+
+    fprintf(file, "  \"frames\": [");
+    for (size_t i = 0; i < this->frames.size(); ++i) {
+        const FrameRecord& frame = this->frames[i];
+        const FrameStats& s = frame.stats;
+        fprintf(file, "%s\n    {\"cpuMs\": %.4f, ", i == 0 ? "" : ",",
+                frame.cpuMs);
+        if (frame.gpuMs < 0.0) {
+            fprintf(file, "\"gpuMs\": null, ");
+        } else {
+            fprintf(file, "\"gpuMs\": %.4f, ", frame.gpuMs);
+        }
+        fprintf(file,
+                "\"drawCalls\": %u, \"stateChanges\": %u, "
+                "\"skippedCalls\": %u, \"visibleObjects\": %u, "
+                "\"culledObjects\": %u, \"vertices\": %u}",
+                s.drawCalls, s.stateChanges, s.skippedCalls, s.visibleObjects,
+                s.culledObjects, s.vertices);
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    bool ok = ferror(file) == 0;
+    if (path != nullptr) {
+        ok = fclose(file) == 0 && ok;
+    } else {
+        fflush(file);
+    }
+    return ok;
+}
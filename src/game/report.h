@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GAME_REPORT
+#define _HOMD_GAME_REPORT
+
+#include <graphics/graphics.h>
+#include <vector>
+
+// What a headless run measured for one frame
+using FrameRecord = struct FrameRecord {
+    // Wall time of the updates and of recording and submitting the draws
+    double cpuMs;
+    // Time the GPU spent on the frame, negative when it is unknown
+    double gpuMs;
+    // Counters of the frame
+    FrameStats stats;
+};
+
+// Frame times over a window of frames, for percentiles
+class FrameTimes {
+    std::vector<double> times;
+    // Sorted copy of times, kept to not reallocate
+    mutable std::vector<double> sorted;
+
+   public:
+    // Adds the time of a frame in milliseconds
+    void add(double ms);
+
+    // Forgets every frame
+    void clear();
+
+    [[nodiscard]] size_t size() const;
+
+    /**
+     * Time at least the given share of the frames took no longer than,
+     * by the nearest rank.
+     *
+     * @param p the percentile, from 0 to 100
+     *
+     * @return the time in milliseconds, 0 without frames
+     */
+    [[nodiscard]] double percentile(double p) const;
+};
+
+// Collects the frames of a headless run and writes them out as JSON
+class FrameReport {
+    std::vector<FrameRecord> frames;
+
+   public:
+    /**
+     * Makes room for the frames of a run up front, so recording does not
+     * allocate while it is timed.
+     *
+     * @param count the number of frames
+     */
+    void reserve(int count);
+
+    // Adds the record of the next frame
+    void add(const FrameRecord& record);
+
+    /**
+     * Fills in the GPU time of a frame, which comes in a few frames late.
+     *
+     * @param frame the index of the frame
+     * @param ms the GPU time in milliseconds
+     */
+    void setGpuTime(size_t frame, double ms);
+
+    /**
+     * Writes the run settings, a summary and every frame as JSON.
+     *
+     * @param path the file to write, nullptr for stdout
+     * @param renderer the GL renderer string
+     * @param width the width of the render target
+     * @param height the height of the render target
+     *
+     * @return false if the file could not be written
+     */
+    bool write(const char* path,
+               const char* renderer,
+               int width,
+               int height) const;
+};
+
+#endif
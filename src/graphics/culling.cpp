@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/culling.h>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(HOMD_SIMD_SSE)
+#include <immintrin.h>
+#elif defined(HOMD_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+Bounds computeBounds(const void* vertices, int count, size_t stride) {
+    Bounds bounds = {};
+    if (count <= 0) {
+        return bounds;
+    }
+
+    const auto* bytes = (const unsigned char*)vertices;
+    Aabb& box = bounds.box;
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = FLT_MAX;
+        box.max[axis] = -FLT_MAX;
+    }
+    for (int i = 0; i < count; ++i) {
+        float p[3];
+        memcpy(p, bytes + i * stride, sizeof p);
+        for (int axis = 0; axis < 3; ++axis) {
+            box.min[axis] = std::fmin(box.min[axis], p[axis]);
+            box.max[axis] = std::fmax(box.max[axis], p[axis]);
+        }
+    }
+
+    // Tighter than half the diagonal of the box for round meshes
+    float radiusSq = 0.0F;
+    for (int axis = 0; axis < 3; ++axis) {
+        bounds.center[axis] = (box.min[axis] + box.max[axis]) * 0.5F;
+    }
+    for (int i = 0; i < count; ++i) {
+        float p[3];
+        memcpy(p, bytes + i * stride, sizeof p);
+        float dx = p[0] - bounds.center[0];
+        float dy = p[1] - bounds.center[1];
+        float dz = p[2] - bounds.center[2];
+        radiusSq = std::fmax(radiusSq, dx * dx + dy * dy + dz * dz);
+    }
+    bounds.radius = std::sqrt(radiusSq);
+    return bounds;
+}
+
+float boundsRadiusAroundOrigin(const Bounds& bounds) {
+    const float* c = bounds.center;
+    return std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]) + bounds.radius;
+}
+
+Frustum extractFrustum(const float* m) {
+    // Rows of the column-major matrix
+    float rows[4][4];
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            rows[row][col] = m[col * 4 + row];
+        }
+    }
+
+    // Left, right, bottom, top, near and far, clip space keeps
+    // -w <= x, y, z <= w
+    Frustum frustum;
+    for (int i = 0; i < 6; ++i) {
+        const float* axis = rows[i / 2];
+        float sign = (i & 1) == 0 ? 1.0F : -1.0F;
+        float plane[4];
+        for (int k = 0; k < 4; ++k) {
+            plane[k] = rows[3][k] + sign * axis[k];
+        }
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] +
+                                 plane[2] * plane[2]);
+        float scale = length > 0.0F ? 1.0F / length : 0.0F;
+        frustum.planes[i] = {plane[0] * scale, plane[1] * scale,
+                             plane[2] * scale, plane[3] * scale};
+    }
+    return frustum;
+}
+
+// One sphere against every plane
+static bool sphereVisible(const Frustum& frustum,
+                          float x,
+                          float y,
+                          float z,
+                          float radius) {
+    for (const Vec4& p : frustum.planes) {
+        if (p.x * x + p.y * y + p.z * z + p.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int cullSpheres(const Frustum& frustum,
+                const float* x,
+                const float* y,
+                const float* z,
+                const float* radius,
+                int count,
+                uint8_t* visible) {
+    int visibleCount = 0;
+    int i = 0;
+
+#if defined(HOMD_SIMD_AVX)
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 negRadius =
+            _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const Vec4& p : frustum.planes) {
+            __m256 d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(p.x)),
+                              _mm256_mul_ps(py, _mm256_set1_ps(p.y))),
+                _mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(p.z)),
+                              _mm256_set1_ps(p.w)));
+            inside =
+                _mm256_and_ps(inside, _mm256_cmp_ps(d, negRadius, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; ++lane) {
+            visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+        }
+        visibleCount += __builtin_popcount(mask);
+    }
+#endif
+#if defined(HOMD_SIMD_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 negRadius =
+            _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const Vec4& p : frustum.planes) {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(p.x)),
+                           _mm_mul_ps(py, _mm_set1_ps(p.y))),
+                _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(p.z)), _mm_set1_ps(p.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane) {
+            visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+        }
+        visibleCount += __builtin_popcount(mask);
+    }
+#elif defined(HOMD_SIMD_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t px = vld1q_f32(x + i);
+        float32x4_t py = vld1q_f32(y + i);
+        float32x4_t pz = vld1q_f32(z + i);
+        float32x4_t negRadius = vnegq_f32(vld1q_f32(radius + i));
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFU);
+        for (const Vec4& p : frustum.planes) {
+            float32x4_t d = vdupq_n_f32(p.w);
+            d = vmlaq_n_f32(d, px, p.x);
+            d = vmlaq_n_f32(d, py, p.y);
+            d = vmlaq_n_f32(d, pz, p.z);
+            inside = vandq_u32(inside, vcgeq_f32(d, negRadius));
+        }
+        uint32_t lanes[4];
+        vst1q_u32(lanes, inside);
+        for (int lane = 0; lane < 4; ++lane) {
+            visible[i + lane] = (uint8_t)(lanes[lane] & 1);
+            visibleCount += (int)(lanes[lane] & 1);
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        bool inside = sphereVisible(frustum, x[i], y[i], z[i], radius[i]);
+        visible[i] = (uint8_t)inside;
+        visibleCount += (int)inside;
+    }
+    return visibleCount;
+}
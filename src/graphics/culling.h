@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_CULLING
+#define _HOMD_GRAPHICS_CULLING
+
+#include <math/mat4.h>
+#include <cstddef>
+#include <cstdint>
+
+// Axis aligned bounding box
+using Aabb = struct Aabb {
+    float min[3];
+    float max[3];
+};
+
+// Bounding volumes of a mesh in its own space
+using Bounds = struct Bounds {
+    Aabb box;
+    // Bounding sphere around the center of the box
+    float center[3];
+    float radius;
+};
+
+// Planes of a view frustum as (a, b, c, d) with unit normals pointing
+// inside, a point p is inside a plane when a*x + b*y + c*z + d >= 0
+using Frustum = struct Frustum {
+    Vec4 planes[6];
+};
+
+/**
+ * Computes the bounds of a mesh.
+ *
+ * @param vertices the vertex data, every vertex starting with its x, y
+ * and z as floats
+ * @param count the number of vertices
+ * @param stride the size of a vertex in bytes
+ */
+Bounds computeBounds(const void* vertices, int count, size_t stride);
+
+/**
+ * Radius of the sphere around the origin of the mesh that holds the
+ * bounding sphere, it stays the same however the mesh is rotated.
+ *
+ * @param bounds the bounds of the mesh
+ */
+float boundsRadiusAroundOrigin(const Bounds& bounds);
+
+/**
+ * Extracts the frustum planes of a projection matrix. With a
+ * projection * view matrix the planes are in world space, with the
+ * projection alone in view space.
+ *
+ * @param m the column-major clip matrix
+ */
+Frustum extractFrustum(const float* m);
+
+/**
+ * Tests spheres against a frustum, several at once.
+ *
+ * The spheres are kept in structure-of-arrays layout so every lane of a
+ * register holds another sphere.
+ *
+ * @param frustum the frustum
+ * @param x the x of the sphere centers
+ * @param y the y of the sphere centers
+ * @param z the z of the sphere centers
+ * @param radius the radii of the spheres
+ * @param count the number of spheres
+ * @param[out] visible 1 for every sphere touching the frustum, 0 for the
+ * rest
+ *
+ * @return the number of visible spheres
+ */
+int cullSpheres(const Frustum& frustum,
+                const float* x,
+                const float* y,
+                const float* z,
+                const float* radius,
+                int count,
+                uint8_t* visible);
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/gputimer.h>
+#include <profile/profiler.h>
+
+void GpuTimer::init() {
+    for (Frame& frame : this->frames) {
+        glGenQueries(GPU_TIMER_MAX_ZONES * 2, frame.queries);
+        frame.pending = false;
+    }
+    this->enabled = true;
+}
+
+void GpuTimer::release() {
+    if (!this->enabled) {
+        return;
+    }
+    for (Frame& frame : this->frames) {
+        glDeleteQueries(GPU_TIMER_MAX_ZONES * 2, frame.queries);
+    }
+    this->enabled = false;
+    this->current = nullptr;
+}
+
+bool GpuTimer::isEnabled() const {
+    return this->enabled;
+}
+
+void GpuTimer::beginFrame() {
+    if (!this->enabled) {
+        return;
+    }
+    if (this->current != nullptr) {
+        this->endFrame();
+    }
+
+    Frame& frame = this->frames[this->nextFrame % GPU_TIMER_LATENCY];
+    if (frame.pending) {
+        this->collect(frame, false);
+    }
+
+#ifdef HOMD_PROFILE
+    // Lines the GPU clock up with the CPU zones, the driver answers this
+    // without waiting on the queued commands
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    this->clockOffset = (int64_t)PROFILE_NOW() - gpuNow;
+#endif
+
+    frame.number = this->nextFrame++;
+    frame.zoneCount = 0;
+    this->current = &frame;
+    this->begin("GPU frame");
+}
+
+int GpuTimer::begin(const char* name) {
+    Frame* frame = this->current;
+    if (frame == nullptr || frame->zoneCount == GPU_TIMER_MAX_ZONES) {
+        return -1;
+    }
+    int zone = frame->zoneCount++;
+    frame->names[zone] = name;
+    frame->closed[zone] = false;
+    glQueryCounter(frame->queries[zone * 2], GL_TIMESTAMP);
+    return zone;
+}
+
+void GpuTimer::end(int zone) {
+    if (zone < 0 || this->current == nullptr) {
+        return;
+    }
+    glQueryCounter(this->current->queries[zone * 2 + 1], GL_TIMESTAMP);
+    this->current->closed[zone] = true;
+}
+
+void GpuTimer::endFrame() {
+    if (this->current == nullptr) {
+        return;
+    }
+    // The frame ends last, once its end is in every other result is too
+    this->end(0);
+    this->current->pending = true;
+    this->current = nullptr;
+}
+
+void GpuTimer::collect(Frame& frame, bool wait) {
+    frame.pending = false;
+    if (!wait) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE,
+                            &available);
+        if (available == 0) {
+            this->droppedFrames++;
+            return;
+        }
+    }
+
+    GLuint64 startNs = 0;
+    GLuint64 endNs = 0;
+    glGetQueryObjectui64v(frame.queries[0], GL_QUERY_RESULT, &startNs);
+    glGetQueryObjectui64v(frame.queries[1], GL_QUERY_RESULT, &endNs);
+    this->finished.push_back(
+        {frame.number, (double)(endNs - startNs) / 1.0e6});
+
+#ifdef HOMD_PROFILE
+    for (int zone = 0; zone < frame.zoneCount; ++zone) {
+        if (!frame.closed[zone]) {
+            continue;
+        }
+        glGetQueryObjectui64v(frame.queries[zone * 2], GL_QUERY_RESULT,
+                              &startNs);
+        glGetQueryObjectui64v(frame.queries[zone * 2 + 1], GL_QUERY_RESULT,
+                              &endNs);
+        PROFILE_GPU_ZONE(frame.names[zone],
+                         (uint64_t)((int64_t)startNs + this->clockOffset),
+                         (uint64_t)((int64_t)endNs + this->clockOffset));
+    }
+#endif
+}
+
+void GpuTimer::flush() {
+    // Oldest first, so the frames come out in order
+    for (int i = 0; i < GPU_TIMER_LATENCY; ++i) {
+        Frame& frame = this->frames[(this->nextFrame + i) % GPU_TIMER_LATENCY];
+        if (frame.pending) {
+            this->collect(frame, true);
+        }
+    }
+}
+
+void GpuTimer::takeFinished(std::vector<GpuFrameTime>& out) {
+    out.swap(this->finished);
+    this->finished.clear();
+}
+
+unsigned int GpuTimer::getDroppedFrames() const {
+    return this->droppedFrames;
+}
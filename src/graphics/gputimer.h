@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_GPUTIMER
+#define _HOMD_GRAPHICS_GPUTIMER
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+// Frames between issuing the queries of a frame and reading them back, so
+// the results are in by then and reading never waits on the GPU
+#define GPU_TIMER_LATENCY 4
+// Zones a frame can time, the frame itself included
+#define GPU_TIMER_MAX_ZONES 128
+
+// GPU time of a finished frame
+using GpuFrameTime = struct GpuFrameTime {
+    // Number of the frame, counted from the first beginFrame
+    uint64_t frame;
+    double ms;
+};
+
+/**
+ * Times frames and spans of GL commands inside them with GL_TIMESTAMP
+ * queries. Timestamps may nest and overlap, unlike GL_TIME_ELAPSED.
+ *
+ * Results are read GPU_TIMER_LATENCY frames later when the query set is
+ * reused. A frame whose results are still not in by then is dropped
+ * rather than waited for.
+ */
+class GpuTimer {
+    using Frame = struct Frame {
+        uint64_t number;
+        int zoneCount;
+        const char* names[GPU_TIMER_MAX_ZONES];
+        // Whether the zone got its end timestamp
+        bool closed[GPU_TIMER_MAX_ZONES];
+        // Begin and end timestamp of every zone
+        GLuint queries[GPU_TIMER_MAX_ZONES * 2];
+        // Whether the queries were issued and not read yet
+        bool pending;
+    };
+
+    Frame frames[GPU_TIMER_LATENCY] = {};
+    // The frame being recorded, nullptr between frames
+    Frame* current = nullptr;
+    uint64_t nextFrame = 0;
+    bool enabled = false;
+    // Profiler time minus GPU time in nanoseconds
+    int64_t clockOffset = 0;
+    unsigned int droppedFrames = 0;
+    std::vector<GpuFrameTime> finished;
+
+    /**
+     * Reads the results of a frame.
+     *
+     * @param frame the frame to read
+     * @param wait whether to wait for results that are not in yet,
+     * otherwise the frame is dropped
+     */
+    void collect(Frame& frame, bool wait);
+
+   public:
+    // Whether every draw gets a zone of its own besides the passes
+    bool timeDraws = false;
+
+    GpuTimer() = default;
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    // Creates the queries, needs a context that has timer queries
+    void init();
+
+    // Deletes the queries
+    void release();
+
+    [[nodiscard]] bool isEnabled() const;
+
+    // Starts a frame, reading back the one that used its queries before
+    void beginFrame();
+
+    /**
+     * Starts timing the commands issued from now on.
+     *
+     * @param name the name of the zone, must outlive the timer
+     *
+     * @return the zone to pass to end, -1 if it is not timed
+     */
+    int begin(const char* name);
+
+    /**
+     * Stops timing a zone.
+     *
+     * @param zone what begin returned
+     */
+    void end(int zone);
+
+    // Ends the frame, its zones have to be ended before
+    void endFrame();
+
+    // Waits for every frame still in flight, for the end of a run
+    void flush();
+
+    /**
+     * Hands over the frames read back since the last call.
+     *
+     * @param[out] out the frames, in the order they were drawn
+     */
+    void takeFinished(std::vector<GpuFrameTime>& out);
+
+    // Number of frames whose results were not in when they were due
+    [[nodiscard]] unsigned int getDroppedFrames() const;
+};
+
+#endif
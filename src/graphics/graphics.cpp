@@ -17,15 +17,31 @@
 
 #include <GLES3/gl3.h>
 #include <GL/glew.h>
+#include <SDL2/SDL_filesystem.h>
 #include <SDL2/SDL_video.h>
 
 #include <game/game.h>
 #include <graphics/graphics.h>
+#include <math/mat4.h>
+#include <profile/profiler.h>
 #include <window/window.h>
 #include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 
+// Where SDL_GetPrefPath puts the user data of the engine
+#define PREF_ORG "Homd"
+#define PREF_APP "HomdEngine"
+
+// Bytes of vertex data a frame can stream before the buffer grows
+#define VERTEX_STREAM_SIZE (4 * 1024 * 1024)
+
+FrameStats Graphics::stats;
+FrameStats Graphics::lastFrameStats;
+RenderState Graphics::state = {0, 0, {}, {}, {}, {-1, -1, -1, -1}, {}};
+
 #ifdef DEBUG
 void GLAPIENTRY MessageCallback(GLenum source,
                                 GLenum type,
@@ -60,106 +76,373 @@ Graphics::Graphics(Game* game) {
     glDebugMessageCallback(MessageCallback, nullptr);
 #endif
 
-    this->program = glCreateProgram();
+    if (supportsUniformBuffers()) {
+        this->uniforms.init();
+    }
+    this->vertexStream.init(GL_ARRAY_BUFFER, VERTEX_STREAM_SIZE);
+
+    // Program binaries go next to the rest of the user data
+    char* prefPath = SDL_GetPrefPath(PREF_ORG, PREF_APP);
+    this->programCache.init(prefPath != nullptr ? prefPath : "");
+    SDL_free(prefPath);
+
+    if (this->pGame->isHeadless()) {
+        const HeadlessConfig& config = this->pGame->getHeadlessConfig();
+        this->createOffscreenTarget(config.width, config.height);
+    }
+    if (supportsTimerQueries()) {
+        this->gpuTimer.init();
+    }
+}
+
+Graphics::~Graphics() {
+    this->gpuTimer.release();
+    if (supportsUniformBuffers()) {
+        this->uniforms.release();
+    }
+    this->vertexStream.destroy();
+    glDeleteRenderbuffers(1, &this->depthRenderBufObj);
+    glDeleteRenderbuffers(1, &this->colorRenderBufObj);
+    glDeleteFramebuffers(1, &this->frameBufObj);
+    // The cached state describes the context going away
+    invalidateState();
+    SDL_GL_DeleteContext(this->context);
 }
 
-void Graphics::compileShader(const char* shaderSrc, int shaderType) const {
-    GLuint shader = glCreateShader(shaderType);
-    glShaderSource(shader, 1, &shaderSrc, nullptr);
-    glCompileShader(shader);
-    glAttachShader(this->program, shader);
-#ifdef DEBUG
-    char msg[512];
-    glGetShaderInfoLog(shader, sizeof msg, nullptr, msg);
-    std::cout << "Vertex shader info: " << msg << "\n";
-#endif
+void Graphics::createOffscreenTarget(int width, int height) {
+    // Without framebuffer objects the hidden window is drawn into instead
+    if (!supportsFramebuffers()) {
+        fprintf(stderr, "No framebuffer objects, drawing to the window\n");
+        return;
+    }
+
+    glGenRenderbuffers(1, &this->colorRenderBufObj);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->colorRenderBufObj);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &this->depthRenderBufObj);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->depthRenderBufObj);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+                          height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &this->frameBufObj);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->frameBufObj);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, this->colorRenderBufObj);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, this->depthRenderBufObj);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Offscreen target is incomplete\n");
+    }
 }
 
-void Graphics::bindAttribLoc(int argIndex, const char* argName) const {
-    glBindAttribLocation(this->program, argIndex, argName);
+void Graphics::useProgram(const ShaderProgram* program) {
+    GLuint id = program != nullptr ? program->getId() : 0;
+    if (state.program == id) {
+        stats.skippedCalls++;
+        return;
+    }
+    glUseProgram(id);
+    state.program = id;
 }
 
-void Graphics::useProgram() const {
-    glLinkProgram(program);
-#ifdef DEBUG
-    char msg[512];
-    glGetProgramInfoLog(program, sizeof msg, nullptr, msg);
-    std::cout << "Program info: " << msg << "\n";
-#endif
-    glUseProgram(program);
+void Graphics::deleteProgram(GLuint program) {
+    glDeleteProgram(program);
+    // The name can come back with another program
+    for (auto it = state.uniforms.begin(); it != state.uniforms.end();) {
+        if (it->first >> 32 == program) {
+            it = state.uniforms.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
-GLint Graphics::getUniformLoc(const char* name) const {
-    return glGetUniformLocation(this->program, name);
+bool Graphics::cacheUniform(GLint position, const GLfloat* value, int count) {
+    if (position < 0) {
+        return false;
+    }
+
+    uint64_t key = (uint64_t)state.program << 32 | (uint32_t)position;
+    auto& cached = state.uniforms[key];
+    if (memcmp(cached.data(), value, count * sizeof(GLfloat)) == 0) {
+        return false;
+    }
+    memcpy(cached.data(), value, count * sizeof(GLfloat));
+    return true;
 }
 
 void Graphics::setUniformValue(GLint position, const GLfloat value[4]) {
+    if (!cacheUniform(position, value, 4)) {
+        stats.skippedCalls++;
+        return;
+    }
     glUniform4fv(position, 1, value);
 }
 
 void Graphics::setUniformMatrixValue(GLint position, const GLfloat value[16]) {
+    if (!cacheUniform(position, value, 16)) {
+        stats.skippedCalls++;
+        return;
+    }
     glUniformMatrix4fv(position, 1, GL_FALSE, value);
 }
 
-void Graphics::storeVertexBufObj(GLuint& dest, GLsizeiptr size, int* target) {
+void Graphics::storeVertexBufObj(GLuint& dest,
+                                 GLsizeiptr size,
+                                 const int* target) {
     // Store the vertices in a vertex buffer object
     glGenBuffers(1, &dest);
-    glBindBuffer(GL_ARRAY_BUFFER, dest);
+    bindBuffer(GL_ARRAY_BUFFER, dest);
     glBufferData(GL_ARRAY_BUFFER, size, target, GL_STATIC_DRAW);
 }
 
+void Graphics::uploadBuffer(GLuint& dest,
+                            GLenum target,
+                            GLsizeiptr size,
+                            const void* data) {
+    if (dest == 0) {
+        glGenBuffers(1, &dest);
+    }
+    bindBuffer(target, dest);
+    glBufferData(target, size, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, size, data);
+}
+
 void Graphics::enable(int cap) {
+    auto known = state.caps.find(cap);
+    if (known != state.caps.end() && known->second) {
+        stats.skippedCalls++;
+        return;
+    }
     glEnable(cap);
+    state.caps[cap] = true;
 }
 
-void Graphics::drawArrays(GLuint& vertexBufObj,
-                          int mode,
-                          int stripCount,
-                          VertexStrip* strips,
-                          int attrBindingIdx,
-                          int attrCount,
-                          int attrOffset,
-                          GLsizei attrSize) {
-    /* Set the vertex buffer object to use */
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufObj);
+void Graphics::disable(int cap) {
+    auto known = state.caps.find(cap);
+    if (known != state.caps.end() && !known->second) {
+        stats.skippedCalls++;
+        return;
+    }
+    glDisable(cap);
+    state.caps[cap] = false;
+}
+
+void Graphics::setViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (state.viewport[0] == x && state.viewport[1] == y &&
+        state.viewport[2] == width && state.viewport[3] == height) {
+        stats.skippedCalls++;
+        return;
+    }
+    glViewport(x, y, width, height);
+    state.viewport[0] = x;
+    state.viewport[1] = y;
+    state.viewport[2] = width;
+    state.viewport[3] = height;
+}
+
+void Graphics::bindVertexArray(GLuint vertexArrayObj) {
+    if (state.vertexArrayObj == vertexArrayObj) {
+        stats.skippedCalls++;
+        return;
+    }
+    glBindVertexArray(vertexArrayObj);
+    state.vertexArrayObj = vertexArrayObj;
+    stats.stateChanges++;
+}
+
+void Graphics::bindBuffer(GLenum target, GLuint bufObj) {
+    // The element array binding belongs to the vertex array object
+    if (target != GL_ELEMENT_ARRAY_BUFFER) {
+        auto known = state.buffers.find(target);
+        if (known != state.buffers.end() && known->second == bufObj) {
+            stats.skippedCalls++;
+            return;
+        }
+        state.buffers[target] = bufObj;
+    }
+    glBindBuffer(target, bufObj);
+}
+
+void Graphics::bindBufferRange(GLenum target,
+                               GLuint index,
+                               GLuint bufObj,
+                               GLintptr offset,
+                               GLsizeiptr size) {
+    std::array<GLintptr, 3> range = {(GLintptr)bufObj, offset, size};
+    auto known = state.bufferRanges.find(target << 16 | index);
+    if (known != state.bufferRanges.end() && known->second == range) {
+        stats.skippedCalls++;
+        return;
+    }
+    glBindBufferRange(target, index, bufObj, offset, size);
+    state.bufferRanges[target << 16 | index] = range;
+    // Binding a range also changes the generic binding of the target
+    state.buffers[target] = bufObj;
+    stats.stateChanges++;
+}
+
+bool Graphics::supportsUniformBuffers() {
+    return GLEW_VERSION_3_1 || GLEW_ARB_uniform_buffer_object;
+}
+
+bool Graphics::supportsFramebuffers() {
+    return GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object;
+}
+
+bool Graphics::supportsTimerQueries() {
+    return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+void Graphics::invalidateState() {
+    state = RenderState{0, 0, {}, {}, {}, {-1, -1, -1, -1}, {}};
+    glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*)&state.program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, (GLint*)&state.vertexArrayObj);
+}
+
+void Graphics::createVertexArrayObj(GLuint& dest,
+                                    GLuint vertexBufObj,
+                                    GLuint indexBufObj,
+                                    int attrBindingIdx,
+                                    const VertexLayout& layout,
+                                    const InstanceStream* streams,
+                                    int streamCount) {
+    glGenVertexArrays(1, &dest);
+    bindVertexArray(dest);
 
     /* Set up the position of the attributes in the vertex buffer object */
-    for (int i = 0; i < attrCount; ++i) {
-        glEnableVertexAttribArray(i);
-        glVertexAttribFormat(i, 3, GL_FLOAT, GL_FALSE,
-                             attrOffset + i * attrSize);
-        glVertexAttribBinding(i, attrBindingIdx);
+    for (int i = 0; i < layout.attribCount; ++i) {
+        const VertexAttrib& attrib = layout.attribs[i];
+        glEnableVertexAttribArray(attrib.location);
+        glVertexAttribFormat(attrib.location, attrib.size, attrib.type,
+                             attrib.normalized, attrib.offset);
+        glVertexAttribBinding(attrib.location, attrBindingIdx);
+    }
+    glBindVertexBuffer(attrBindingIdx, vertexBufObj, 0, layout.stride);
+
+    /* Instance streams get their own binding points after the mesh */
+    for (int s = 0; s < streamCount; ++s) {
+        GLuint binding = attrBindingIdx + 1 + s;
+        for (GLuint a = 0; a < streams[s].attrCount; ++a) {
+            GLuint attr = streams[s].firstAttr + a;
+            glEnableVertexAttribArray(attr);
+            glVertexAttribFormat(attr, 4, GL_FLOAT, GL_FALSE,
+                                 a * 4 * sizeof(GLfloat));
+            glVertexAttribBinding(attr, binding);
+        }
+        glVertexBindingDivisor(binding, 1);
+    }
+
+    if (indexBufObj != 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufObj);
     }
 
-    glBindVertexBuffer(attrBindingIdx, vertexBufObj, 0, attrCount * attrSize);
+    // Unbind so later buffer setup does not end up in this object
+    bindVertexArray(0);
+}
+
+// Points the instance binding points of the bound vertex array object at
+// the requested instances
+static void bindInstanceStreams(int attrBindingIdx,
+                                const InstanceStream* streams,
+                                int streamCount,
+                                int firstInstance) {
+    for (int s = 0; s < streamCount; ++s) {
+        glBindVertexBuffer(
+            attrBindingIdx + 1 + s, streams[s].bufObj,
+            streams[s].offset + (GLintptr)firstInstance * streams[s].stride,
+            streams[s].stride);
+    }
+    Graphics::stats.stateChanges += streamCount;
+}
+
+void Graphics::drawArrays(GLuint vertexArrayObj,
+                          int mode,
+                          int stripCount,
+                          const VertexStrip* strips) {
+    PROFILE_ZONE("Graphics::drawArrays");
+    bindVertexArray(vertexArrayObj);
 
     /* Draw the triangle strips that comprise the gear */
     for (int n = 0; n < stripCount; ++n) {
         glDrawArrays(mode, strips[n].first, strips[n].count);
+        stats.vertices += strips[n].count;
     }
+    stats.drawCalls += stripCount;
+}
+
+void Graphics::drawArraysInstanced(GLuint vertexArrayObj,
+                                   int mode,
+                                   int stripCount,
+                                   const VertexStrip* strips,
+                                   int attrBindingIdx,
+                                   const InstanceStream* streams,
+                                   int streamCount,
+                                   int firstInstance,
+                                   int instanceCount) {
+    bindVertexArray(vertexArrayObj);
+    bindInstanceStreams(attrBindingIdx, streams, streamCount, firstInstance);
 
-    /* Disable the attributes */
-    for (int i = attrCount - 1; i >= 0; --i) {
-        glDisableVertexAttribArray(i);
+    for (int n = 0; n < stripCount; ++n) {
+        glDrawArraysInstanced(mode, strips[n].first, strips[n].count,
+                              instanceCount);
+        stats.vertices += strips[n].count * instanceCount;
     }
+    stats.drawCalls += stripCount;
+}
+
+void Graphics::drawElements(GLuint vertexArrayObj,
+                            int mode,
+                            GLsizei indexCount) {
+    bindVertexArray(vertexArrayObj);
+
+    glDrawElements(mode, indexCount, GL_UNSIGNED_INT, nullptr);
+    stats.drawCalls++;
+    stats.vertices += indexCount;
+}
+
+void Graphics::drawElementsInstanced(GLuint vertexArrayObj,
+                                     int mode,
+                                     GLsizei indexCount,
+                                     int attrBindingIdx,
+                                     const InstanceStream* streams,
+                                     int streamCount,
+                                     int firstInstance,
+                                     int instanceCount) {
+    bindVertexArray(vertexArrayObj);
+    bindInstanceStreams(attrBindingIdx, streams, streamCount, firstInstance);
+
+    glDrawElementsInstanced(mode, indexCount, GL_UNSIGNED_INT, nullptr,
+                            instanceCount);
+    stats.drawCalls++;
+    stats.vertices += indexCount * instanceCount;
+}
+
+bool Graphics::supportsInstancing() {
+    return GLEW_VERSION_3_3 ||
+           (GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced);
+}
+
+bool Graphics::supportsPackedVertices() {
+    return GLEW_VERSION_3_3 || (GLEW_ARB_half_float_vertex &&
+                                GLEW_ARB_vertex_type_2_10_10_10_rev);
+}
+
+void Graphics::storeIndexBufObj(GLuint& dest,
+                                GLsizeiptr size,
+                                const GLuint* indices) {
+    // The element buffer binding is part of the vertex array object state,
+    // make sure this one does not end up in whatever was drawn last.
+    bindVertexArray(0);
+    glGenBuffers(1, &dest);
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER, dest);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
 }
 
 void Graphics::mulMat4x4(GLfloat* m, const GLfloat* n) {
-    GLfloat tmp[16];
-    const GLfloat* row;
-    const GLfloat* column;
-    div_t d;
-
-    for (int i = 0; i < 16; i++) {
-        tmp[i] = 0;
-        d = div(i, 4);
-        row = n + (ptrdiff_t)(d.quot * 4);
-        column = m + d.rem;
-        for (int j = 0; j < 4; j++) {
-            tmp[i] += row[j] * column[(ptrdiff_t)(j * 4)];
-        }
-    }
-    memcpy(m, &tmp, sizeof tmp);
+    Mat4::mul(m, m, n);
 }
 
 void Graphics::rotMat4x4(GLfloat* m,
@@ -167,34 +450,11 @@ void Graphics::rotMat4x4(GLfloat* m,
                          GLfloat x,
                          GLfloat y,
                          GLfloat z) {
-    double sin;
-    double cos;
-
-    sincos(angle, &sin, &cos);
-    GLfloat r[16] = {(GLfloat)(x * x * (1 - cos) + cos),
-                     (GLfloat)(y * x * (1 - cos) + z * sin),
-                     (GLfloat)(x * z * (1 - cos) - y * sin),
-                     0,
-                     (GLfloat)(x * y * (1 - cos) - z * sin),
-                     (GLfloat)(y * y * (1 - cos) + cos),
-                     (GLfloat)(y * z * (1 - cos) + x * sin),
-                     0,
-                     (GLfloat)(x * z * (1 - cos) + y * sin),
-                     (GLfloat)(y * z * (1 - cos) - x * sin),
-                     (GLfloat)(z * z * (1 - cos) + cos),
-                     0,
-                     0,
-                     0,
-                     0,
-                     1};
-
-    mulMat4x4(m, r);
+    Mat4::rotate(m, angle, x, y, z);
 }
 
 void Graphics::tlateMat4x4(GLfloat* m, GLfloat x, GLfloat y, GLfloat z) {
-    GLfloat t[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1};
-
-    mulMat4x4(m, t);
+    Mat4::translate(m, x, y, z);
 }
 
 void Graphics::identMat4x4(GLfloat* m) {
@@ -207,30 +467,13 @@ void Graphics::identMat4x4(GLfloat* m) {
 }
 
 void Graphics::tposeMat4x4(GLfloat* m) {
-    GLfloat t[16] = {m[0], m[4], m[8],  m[12], m[1], m[5], m[9],  m[13],
-                     m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]};
-
-    memcpy(m, t, sizeof(t));
+    Mat4::transpose(m, m);
 }
 
 void Graphics::invMat4x4(GLfloat* m) {
-    GLfloat t[16];
-    identMat4x4(t);
-
-    // Extract and invert the translation part 't'. The inverse of a
-    // translation matrix can be calculated by negating the translation
-    // coordinates.
-    t[12] = -m[12];
-    t[13] = -m[13];
-    t[14] = -m[14];
-
-    // Invert the rotation part 'r'. The inverse of a rotation matrix is
-    // equal to its transpose.
-    m[12] = m[13] = m[14] = 0;
-    tposeMat4x4(m);
-
-    // inv(m) = inv(r) * inv(t)
-    mulMat4x4(m, t);
+    // Only rotations and translations end up in our model view matrices,
+    // so the cheap rigid inverse is enough.
+    Mat4::invertRigid(m, m);
 }
 
 void Graphics::calcPersProjTform(GLfloat* m,
@@ -238,34 +481,32 @@ void Graphics::calcPersProjTform(GLfloat* m,
                                  GLfloat aspect,
                                  GLfloat zNear,
                                  GLfloat zFar) {
-    GLfloat tmp[16];
-    identMat4x4(tmp);
-
-    double sine;
-    double cosine;
-    double cotangent;
-    double deltaZ;
-    GLfloat radians = yFOV / 2.0F * (float)M_PI / 180.0F;
+    Mat4::perspective(m, yFOV, aspect, zNear, zFar);
+}
 
-    deltaZ = zFar - zNear;
-    sincos(radians, &sine, &cosine);
+void Graphics::beginFrame() {
+    this->gpuTimer.beginFrame();
+}
 
-    if ((deltaZ == 0) || (sine == 0) || (aspect == 0)) {
-        return;
+void Graphics::draw() {
+    {
+        PROFILE_ZONE("RenderQueue::execute");
+        this->queue.execute(this->uniforms, &this->gpuTimer);
+    }
+    // The swap belongs to the next frame on the GPU clock
+    this->gpuTimer.endFrame();
+    if (this->pGame->isHeadless()) {
+        // Nothing to present, just get the commands going
+        glFlush();
+    } else {
+        PROFILE_ZONE("SDL_GL_SwapWindow");
+        SDL_GL_SwapWindow(this->pGame->pWindow->window);
     }
 
-    cotangent = cosine / sine;
-
-    tmp[0] = (float)cotangent / aspect;
-    tmp[5] = (float)cotangent;
-    tmp[10] = -(zFar + zNear) / (float)deltaZ;
-    tmp[11] = -1;
-    tmp[14] = -2 * zNear * zFar / (float)deltaZ;
-    tmp[15] = 0;
-
-    memcpy(m, tmp, sizeof(tmp));
+    lastFrameStats = stats;
+    stats = FrameStats{};
+    if (supportsUniformBuffers()) {
+        this->uniforms.endFrame();
+    }
+    this->vertexStream.endFrame();
 }
-
-void Graphics::draw() {
-    SDL_GL_SwapWindow(this->pGame->pWindow->window);
-}
\ No newline at end of file
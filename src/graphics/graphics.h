@@ -23,49 +23,265 @@
 #include <GLES3/gl3.h>
 #include <GL/glew.h>
 #include <SDL2/SDL_video.h>
+#include <graphics/gputimer.h>
+#include <graphics/programcache.h>
+#include <graphics/renderqueue.h>
+#include <graphics/shader.h>
+#include <graphics/stream.h>
+#include <graphics/uniforms.h>
+#include <graphics/vertex.h>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
 
 class Game;
 class Window;
 
-// Struct describing the vertices in triangle strip
-using VertexStrip = struct VertexStrip {
-    // First vertex in the strip
-    GLint first;
-    // Number of consecutive verices in the strip after the first
-    GLint count;
+// Struct describing a buffer of per-instance attributes. Every attribute
+// is a vec4 and they follow each other inside an instance, a mat4 takes
+// four consecutive attributes.
+using InstanceStream = struct InstanceStream {
+    // Buffer object holding the instance data
+    GLuint bufObj;
+    // Offset of the first instance inside the buffer object
+    GLintptr offset;
+    // Location of the first attribute the stream feeds
+    GLuint firstAttr;
+    // Number of consecutive vec4 attributes per instance
+    GLuint attrCount;
+    // Distance between two instances in bytes
+    GLsizei stride;
+};
+
+// Counters collected while drawing a frame
+using FrameStats = struct FrameStats {
+    // Number of glDraw* calls issued
+    unsigned int drawCalls;
+    // Number of vertex array and buffer binds issued for draws
+    unsigned int stateChanges;
+    // Number of GL calls the render state cache found redundant
+    unsigned int skippedCalls;
+    // Number of objects the scene found inside and outside the frustum
+    unsigned int visibleObjects;
+    unsigned int culledObjects;
+    // Number of vertices or indices the draws read, every instance counted
+    unsigned int vertices;
+};
+
+// Mirror of the GL state set through Graphics, used to skip calls that
+// would not change anything. Buffer bindings that live inside a vertex
+// array object are not tracked here.
+using RenderState = struct RenderState {
+    GLuint program;
+    GLuint vertexArrayObj;
+    // Bound buffer per binding target
+    std::unordered_map<GLenum, GLuint> buffers;
+    // Buffer, offset and size per (target << 16 | index) binding point
+    std::unordered_map<GLuint, std::array<GLintptr, 3>> bufferRanges;
+    // Known state of the capabilities, missing ones are unknown
+    std::unordered_map<GLenum, bool> caps;
+    GLint viewport[4];
+    // Last value set per (program << 32 | location)
+    std::unordered_map<uint64_t, std::array<GLfloat, 16>> uniforms;
 };
 
 class Graphics {
     Game* pGame;
     SDL_GLContext context = nullptr;
-    GLuint program;
+
+    static RenderState state;
+
+    /**
+     * Remembers a uniform value of the current program.
+     *
+     * @return false if the uniform already has this value
+     */
+    static bool cacheUniform(GLint position, const GLfloat* value, int count);
+
+    // Render target of a headless run, 0 when drawing to the window
+    GLuint frameBufObj = 0;
+    GLuint colorRenderBufObj = 0;
+    GLuint depthRenderBufObj = 0;
+
+    /**
+     * Creates a framebuffer object to draw into instead of the window and
+     * binds it.
+     *
+     * @param width the width of the target
+     * @param height the height of the target
+     */
+    void createOffscreenTarget(int width, int height);
 
    public:
+    // Uniform block data of the frame being drawn
+    UniformRing uniforms;
+    // Per frame vertex and instance data
+    StreamBuffer vertexStream;
+    // Linked programs kept across runs
+    ProgramCache programCache;
+    // Draws of the frame being built, issued sorted when it is presented
+    RenderQueue queue;
+    // GPU time of the frames and of the passes inside them
+    GpuTimer gpuTimer;
+
+    // Counters of the frame being drawn
+    static FrameStats stats;
+    // Counters of the last presented frame
+    static FrameStats lastFrameStats;
+
     Graphics(Game*);
-    ~Graphics() = default;
+    ~Graphics();
 
     void setGLContext();
-    void compileShader(const char* shaderSrc, int shaderType) const;
-    void bindAttribLoc(int, const char*) const;
-    void useProgram() const;
-    GLint getUniformLoc(const char* name) const;
+    // Makes the program current, uniforms set afterwards go to it
+    static void useProgram(const ShaderProgram* program);
+    // Deletes a program object and the uniform values cached for it
+    static void deleteProgram(GLuint program);
     static void setUniformValue(GLint, const GLfloat[4]);
     static void setUniformMatrixValue(GLint, const GLfloat[16]);
 
+    // Starts a frame, the GPU time of the frame counts from here
+    void beginFrame();
+
+    // Issues the queued draws and presents the frame
     void draw();
 
-    static void storeVertexBufObj(GLuint&, GLsizeiptr, int*);
+    static void storeVertexBufObj(GLuint&, GLsizeiptr, const int*);
+
+    /**
+     * Uploads data that changes every frame into a buffer object, creating
+     * the buffer on first use. The previous storage is orphaned so the
+     * driver does not wait on draws still reading from it.
+     *
+     * @param[in,out] dest the buffer object, 0 to create one
+     * @param target the buffer binding target
+     * @param size the size of the data in bytes
+     * @param data the data to upload
+     */
+    static void uploadBuffer(GLuint& dest,
+                             GLenum target,
+                             GLsizeiptr size,
+                             const void* data);
+
+    /**
+     * Creates a vertex array object that remembers where the attributes of
+     * a mesh live, so drawing it only takes binding the object.
+     *
+     * The per vertex attributes are read as the layout describes. The
+     * formats of the instance streams are recorded too, their buffers get
+     * bound when drawing since the offset changes.
+     *
+     * @param[out] dest the vertex array object
+     * @param vertexBufObj the vertex buffer object of the mesh
+     * @param indexBufObj the index buffer object of the mesh, or 0
+     * @param attrBindingIdx the binding point of the mesh buffer
+     * @param layout the layout of the vertices in the buffer
+     * @param streams the per-instance attribute streams, or nullptr
+     * @param streamCount number of streams
+     */
+    static void createVertexArrayObj(GLuint& dest,
+                                     GLuint vertexBufObj,
+                                     GLuint indexBufObj,
+                                     int attrBindingIdx,
+                                     const VertexLayout& layout,
+                                     const InstanceStream* streams = nullptr,
+                                     int streamCount = 0);
 
-    static void drawArrays(GLuint& vertexBufObj,
+    /**
+     * Draws the strips of a mesh one by one.
+     *
+     * @param vertexArrayObj the vertex array object of the mesh
+     * @param mode the primitive type
+     * @param stripCount number of strips in the mesh
+     * @param strips the strips of the mesh
+     */
+    static void drawArrays(GLuint vertexArrayObj,
                            int mode,
                            int stripCount,
-                           VertexStrip* strips,
-                           int attrBindingIdx,
-                           int attrCount,
-                           int attrOffset,
-                           GLsizei attrSize);
+                           const VertexStrip* strips);
+
+    /**
+     * Draws several instances of a mesh with a single call per strip.
+     *
+     * The instance streams advance once per instance instead of per vertex,
+     * they have to match the ones the vertex array object was created with.
+     *
+     * @param vertexArrayObj the vertex array object of the mesh
+     * @param mode the primitive type
+     * @param stripCount number of strips in the mesh
+     * @param strips the strips of the mesh
+     * @param attrBindingIdx the binding point of the mesh buffer
+     * @param streams the per-instance attribute streams
+     * @param streamCount number of streams
+     * @param firstInstance the instance to start reading the streams at
+     * @param instanceCount number of instances to draw
+     */
+    static void drawArraysInstanced(GLuint vertexArrayObj,
+                                    int mode,
+                                    int stripCount,
+                                    const VertexStrip* strips,
+                                    int attrBindingIdx,
+                                    const InstanceStream* streams,
+                                    int streamCount,
+                                    int firstInstance,
+                                    int instanceCount);
+
+    /**
+     * Draws a mesh with a single indexed call.
+     *
+     * @param vertexArrayObj the vertex array object of the mesh, created
+     * with an index buffer object
+     * @param mode the primitive type
+     * @param indexCount number of indices to draw
+     */
+    static void drawElements(GLuint vertexArrayObj,
+                             int mode,
+                             GLsizei indexCount);
+
+    /**
+     * Indexed version of drawArraysInstanced, draws every instance of the
+     * mesh with a single call.
+     */
+    static void drawElementsInstanced(GLuint vertexArrayObj,
+                                      int mode,
+                                      GLsizei indexCount,
+                                      int attrBindingIdx,
+                                      const InstanceStream* streams,
+                                      int streamCount,
+                                      int firstInstance,
+                                      int instanceCount);
+
+    // Whether the context can do instanced draws
+    static bool supportsInstancing();
+
+    // Whether the context reads GL_HALF_FLOAT and GL_INT_2_10_10_10_REV
+    // vertex attributes
+    static bool supportsPackedVertices();
+
+    static void storeIndexBufObj(GLuint&, GLsizeiptr, const GLuint*);
 
     static void enable(int cap);
+    static void disable(int cap);
+    static void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void bindVertexArray(GLuint vertexArrayObj);
+    static void bindBuffer(GLenum target, GLuint bufObj);
+    static void bindBufferRange(GLenum target,
+                                GLuint index,
+                                GLuint bufObj,
+                                GLintptr offset,
+                                GLsizeiptr size);
+
+    // Whether the context has std140 uniform blocks
+    static bool supportsUniformBuffers();
+
+    // Whether the context can draw into framebuffer objects
+    static bool supportsFramebuffers();
+
+    // Whether the context can measure GPU time with queries
+    static bool supportsTimerQueries();
+
+    // Forgets the cached state, needed after GL is called directly
+    static void invalidateState();
 
     /**
      * Multiplies two 4x4 matrices
@@ -113,7 +329,7 @@ class Graphics {
     static void tposeMat4x4(GLfloat*);
 
     /**
-     * Inverts a 4x4 matrix.
+     * Inverts a 4x4 matrix consisting of a rotation and a translation.
      *
      * @param m the matrix to invert
      */
@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/lod.h>
+#include <cfloat>
+
+float projectedSize(const Mat4& projection,
+                    float radius,
+                    float depth,
+                    float viewportHeight) {
+    // Around or behind the eye everything is as large as it gets
+    if (depth <= radius) {
+        return FLT_MAX;
+    }
+    // m[5] maps view space y to clip space, the viewport spans 2 in NDC
+    return radius * projection.m[5] * viewportHeight / depth;
+}
+
+int selectLod(const LodChain& chain, float size, int current) {
+    int level = current < chain.levelCount ? current : chain.levelCount - 1;
+    level = level < 0 ? 0 : level;
+    while (level + 1 < chain.levelCount &&
+           size < chain.switchSize[level] * (1.0F - LOD_HYSTERESIS)) {
+        level++;
+    }
+    while (level > 0 &&
+           size > chain.switchSize[level - 1] * (1.0F + LOD_HYSTERESIS)) {
+        level--;
+    }
+    return level;
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_LOD
+#define _HOMD_GRAPHICS_LOD
+
+#include <math/mat4.h>
+
+// Most detail levels a mesh can have
+#define LOD_MAX_LEVELS 4
+// How far past a switch size, as a fraction of it, the projected size has
+// to go before the level changes, so objects hovering around it do not pop
+#define LOD_HYSTERESIS 0.2F
+
+// Detail levels of a mesh, level 0 being the finest
+using LodChain = struct LodChain {
+    int levelCount;
+    // Projected size in pixels below which level i gives way to level i + 1
+    float switchSize[LOD_MAX_LEVELS - 1];
+};
+
+/**
+ * Projected diameter of a bounding sphere in pixels.
+ *
+ * @param projection the perspective projection matrix
+ * @param radius the radius of the sphere
+ * @param depth the distance of the center along the view direction, the w
+ * of the center in clip space
+ * @param viewportHeight the height of the viewport in pixels
+ */
+float projectedSize(const Mat4& projection,
+                    float radius,
+                    float depth,
+                    float viewportHeight);
+
+/**
+ * Picks the detail level for a projected size, moving away from the
+ * current level only once the size is clearly past a switch size.
+ *
+ * @param chain the levels of the mesh
+ * @param size the projected size in pixels
+ * @param current the level drawn last frame
+ *
+ * @return the level to draw
+ */
+int selectLod(const LodChain& chain, float size, int current);
+
+#endif
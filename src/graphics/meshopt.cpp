@@ -0,0 +1,330 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/meshopt.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Scoring constants of the Forsyth algorithm
+#define CACHE_DECAY_POWER 1.5F
+#define LAST_TRI_SCORE 0.75F
+#define VALENCE_BOOST_SCALE 2.0F
+#define VALENCE_BOOST_POWER 0.5F
+
+void stripsToTriangles(const VertexStrip* strips,
+                       int stripCount,
+                       std::vector<GLuint>& indices) {
+    indices.clear();
+    for (int s = 0; s < stripCount; ++s) {
+        auto first = (GLuint)strips[s].first;
+        for (GLint k = 0; k + 2 < strips[s].count; ++k) {
+            GLuint a = first + k;
+            GLuint b = first + k + 1;
+            GLuint c = first + k + 2;
+            if (a == b || b == c || a == c) {
+                continue;
+            }
+            // Every other triangle of a strip is wound the other way
+            if ((k & 1) != 0) {
+                indices.insert(indices.end(), {b, a, c});
+            } else {
+                indices.insert(indices.end(), {a, b, c});
+            }
+        }
+    }
+}
+
+// FNV-1a over the bytes of a vertex
+static uint32_t hashVertex(const unsigned char* vertex, GLsizei stride) {
+    uint32_t hash = 2166136261U;
+    for (GLsizei i = 0; i < stride; ++i) {
+        hash = (hash ^ vertex[i]) * 16777619U;
+    }
+    return hash;
+}
+
+int weldVertices(const void* vertices,
+                 int count,
+                 GLsizei stride,
+                 std::vector<unsigned char>& welded,
+                 std::vector<GLuint>& indices) {
+    const auto* bytes = (const unsigned char*)vertices;
+    std::vector<GLuint> remap(count);
+    welded.clear();
+    welded.reserve((size_t)count * stride);
+
+    // Open addressing table of welded vertex indices, at most half full
+    // so probe runs stay short
+    size_t tableSize = 1;
+    while (tableSize < (size_t)count * 2) {
+        tableSize <<= 1;
+    }
+    const size_t mask = tableSize - 1;
+    std::vector<GLuint> table(tableSize, ~0U);
+    GLuint unique = 0;
+
+    for (int i = 0; i < count; ++i) {
+        const unsigned char* vertex = bytes + (size_t)i * stride;
+        size_t slot = hashVertex(vertex, stride) & mask;
+        while (table[slot] != ~0U &&
+               memcmp(welded.data() + (size_t)table[slot] * stride, vertex,
+                      stride) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        if (table[slot] == ~0U) {
+            table[slot] = unique++;
+            welded.insert(welded.end(), vertex, vertex + stride);
+        }
+        remap[i] = table[slot];
+    }
+
+    for (auto& index : indices) {
+        index = remap[index];
+    }
+
+    // Welding can turn slivers into triangles with a repeated vertex
+    size_t out = 0;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        GLuint a = indices[t];
+        GLuint b = indices[t + 1];
+        GLuint c = indices[t + 2];
+        if (a != b && b != c && a != c) {
+            indices[out++] = a;
+            indices[out++] = b;
+            indices[out++] = c;
+        }
+    }
+    indices.resize(out);
+    return (int)unique;
+}
+
+// How much the Forsyth algorithm wants to use a vertex next
+static float computeVertexScore(int cachePos, int remaining) {
+    if (remaining == 0) {
+        return -1.0F;
+    }
+
+    float score = 0.0F;
+    if (cachePos < 0) {
+        // Not in the cache, no bonus
+    } else if (cachePos < 3) {
+        // Used by the last triangle, a fixed score keeps from favouring
+        // any of its edges
+        score = LAST_TRI_SCORE;
+    } else {
+        float scaler = 1.0F / (OPTIMIZE_CACHE_SIZE - 3);
+        score = 1.0F - (float)(cachePos - 3) * scaler;
+        score = std::pow(score, CACHE_DECAY_POWER);
+    }
+
+    // Bonus for vertices with few triangles left, so lone triangles do
+    // not get left behind
+    score += VALENCE_BOOST_SCALE *
+             std::pow((float)remaining, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+// Valences above this share the score of this one, the boost is tiny there
+#define MAX_SCORED_VALENCE 32
+
+// computeVertexScore looked up from a table, the pow calls dominate the
+// optimizer otherwise
+static float vertexScore(int cachePos, int remaining) {
+    static const auto table = [] {
+        std::vector<float> scores((OPTIMIZE_CACHE_SIZE + 1) *
+                                  (MAX_SCORED_VALENCE + 1));
+        for (int pos = -1; pos < OPTIMIZE_CACHE_SIZE; ++pos) {
+            for (int v = 0; v <= MAX_SCORED_VALENCE; ++v) {
+                scores[(pos + 1) * (MAX_SCORED_VALENCE + 1) + v] =
+                    computeVertexScore(pos, v);
+            }
+        }
+        return scores;
+    }();
+
+    if (remaining > MAX_SCORED_VALENCE) {
+        remaining = MAX_SCORED_VALENCE;
+    }
+    return table[(cachePos + 1) * (MAX_SCORED_VALENCE + 1) + remaining];
+}
+
+void optimizeVertexCache(std::vector<GLuint>& indices, int vertexCount) {
+    int triCount = (int)indices.size() / 3;
+    if (triCount == 0) {
+        return;
+    }
+
+    // Triangles of every vertex, packed into one array
+    std::vector<int> remaining(vertexCount, 0);
+    for (GLuint index : indices) {
+        remaining[index]++;
+    }
+    std::vector<int> triOffset(vertexCount + 1, 0);
+    for (int v = 0; v < vertexCount; ++v) {
+        triOffset[v + 1] = triOffset[v] + remaining[v];
+    }
+    std::vector<int> vertexTris(indices.size());
+    std::vector<int> filled(vertexCount, 0);
+    for (int t = 0; t < triCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            GLuint v = indices[t * 3 + k];
+            vertexTris[triOffset[v] + filled[v]++] = t;
+        }
+    }
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (int v = 0; v < vertexCount; ++v) {
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triScore(triCount);
+    std::vector<char> emitted(triCount, 0);
+    for (int t = 0; t < triCount; ++t) {
+        triScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] +
+                      score[indices[t * 3 + 2]];
+    }
+
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+    std::vector<GLuint> cache;
+    std::vector<GLuint> newCache;
+    int best = -1;
+    int scan = 0;
+
+    for (int emittedCount = 0; emittedCount < triCount; ++emittedCount) {
+        if (best < 0) {
+            // Nothing in the cache to continue from, start over at the
+            // first triangle left, searching every triangle for the best
+            // one would make islands quadratic
+            best = scan;
+        }
+
+        const GLuint* tri = &indices[(size_t)best * 3];
+        output.insert(output.end(), tri, tri + 3);
+        emitted[best] = 1;
+        while (scan < triCount && emitted[scan] != 0) {
+            scan++;
+        }
+
+        // Take the triangle off its vertices
+        for (int k = 0; k < 3; ++k) {
+            GLuint v = tri[k];
+            int* begin = &vertexTris[triOffset[v]];
+            int* end = begin + remaining[v];
+            for (int* it = begin; it != end; ++it) {
+                if (*it == best) {
+                    *it = *(end - 1);
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // Move its vertices to the front of the cache
+        newCache.assign(tri, tri + 3);
+        for (GLuint v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newCache.push_back(v);
+            }
+        }
+
+        // Rescore what is and what just fell out of the cache
+        best = -1;
+        float bestScore = -1.0F;
+        for (size_t i = 0; i < newCache.size(); ++i) {
+            GLuint v = newCache[i];
+            int pos = i < OPTIMIZE_CACHE_SIZE ? (int)i : -1;
+            cachePos[v] = pos;
+            float newScore = vertexScore(pos, remaining[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+
+            for (int j = 0; j < remaining[v]; ++j) {
+                int t = vertexTris[triOffset[v] + j];
+                triScore[t] += delta;
+                if (pos >= 0 && triScore[t] > bestScore) {
+                    bestScore = triScore[t];
+                    best = t;
+                }
+            }
+        }
+        if (newCache.size() > OPTIMIZE_CACHE_SIZE) {
+            newCache.resize(OPTIMIZE_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+    }
+
+    indices.swap(output);
+}
+
+int optimizeVertexFetch(std::vector<unsigned char>& vertices,
+                        GLsizei stride,
+                        std::vector<GLuint>& indices) {
+    size_t vertexCount = vertices.size() / stride;
+    std::vector<GLuint> remap(vertexCount, ~0U);
+    std::vector<unsigned char> ordered;
+    ordered.reserve(vertices.size());
+
+    GLuint next = 0;
+    for (auto& index : indices) {
+        if (remap[index] == ~0U) {
+            remap[index] = next++;
+            const unsigned char* vertex = &vertices[(size_t)index * stride];
+            ordered.insert(ordered.end(), vertex, vertex + stride);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(ordered);
+    return (int)next;
+}
+
+float computeACMR(const std::vector<GLuint>& indices, int vertexCount) {
+    if (indices.empty()) {
+        return 0.0F;
+    }
+
+    // Time each vertex entered the cache, FIFO caches do not refresh it
+    // on a hit
+    std::vector<long> entered(vertexCount, -1);
+    long time = 0;
+    long misses = 0;
+    for (GLuint index : indices) {
+        if (entered[index] < 0 || time - entered[index] >= ACMR_CACHE_SIZE) {
+            entered[index] = time++;
+            misses++;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+void optimizeStripMesh(const void* vertices,
+                       int count,
+                       GLsizei stride,
+                       const VertexStrip* strips,
+                       int stripCount,
+                       OptimizedMesh& mesh) {
+    stripsToTriangles(strips, stripCount, mesh.indices);
+    mesh.acmrBefore = computeACMR(mesh.indices, count);
+
+    int welded = weldVertices(vertices, count, stride, mesh.vertices,
+                              mesh.indices);
+    optimizeVertexCache(mesh.indices, welded);
+    mesh.nVertices = optimizeVertexFetch(mesh.vertices, stride, mesh.indices);
+    mesh.acmrAfter = computeACMR(mesh.indices, mesh.nVertices);
+}
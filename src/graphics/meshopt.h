@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_MESHOPT
+#define _HOMD_GRAPHICS_MESHOPT
+
+#include <graphics/vertex.h>
+#include <vector>
+
+// Entries of the FIFO post-transform cache ACMR is measured against
+#define ACMR_CACHE_SIZE 32
+// Entries of the LRU cache the triangle order is optimized for
+#define OPTIMIZE_CACHE_SIZE 32
+
+// An indexed triangle list ready to be uploaded
+using OptimizedMesh = struct OptimizedMesh {
+    // Vertex data, stride bytes per vertex
+    std::vector<unsigned char> vertices;
+    int nVertices;
+    std::vector<GLuint> indices;
+    // Average cache miss ratio of the input and the output
+    float acmrBefore;
+    float acmrAfter;
+};
+
+/**
+ * Turns triangle strips into a triangle list, keeping the winding of
+ * every triangle and dropping degenerate ones.
+ *
+ * @param strips the strips
+ * @param stripCount the number of strips
+ * @param[out] indices the triangle list
+ */
+void stripsToTriangles(const VertexStrip* strips,
+                       int stripCount,
+                       std::vector<GLuint>& indices);
+
+/**
+ * Merges vertices whose bytes are identical.
+ *
+ * @param vertices the vertex data
+ * @param count the number of vertices
+ * @param stride the size of a vertex in bytes
+ * @param[out] welded the unique vertices
+ * @param[in,out] indices indices into vertices, rewritten to index welded
+ *
+ * @return the number of unique vertices
+ */
+int weldVertices(const void* vertices,
+                 int count,
+                 GLsizei stride,
+                 std::vector<unsigned char>& welded,
+                 std::vector<GLuint>& indices);
+
+/**
+ * Reorders triangles so vertices are reused while they are still in the
+ * post-transform cache, after Tom Forsyth's linear-speed algorithm.
+ *
+ * @param[in,out] indices the triangle list
+ * @param vertexCount the number of vertices the list indexes
+ */
+void optimizeVertexCache(std::vector<GLuint>& indices, int vertexCount);
+
+/**
+ * Reorders vertices in the order the triangles first use them, so
+ * vertex fetches walk the buffer forward.
+ *
+ * @param[in,out] vertices the vertex data
+ * @param stride the size of a vertex in bytes
+ * @param[in,out] indices the triangle list
+ *
+ * @return the number of vertices still referenced
+ */
+int optimizeVertexFetch(std::vector<unsigned char>& vertices,
+                        GLsizei stride,
+                        std::vector<GLuint>& indices);
+
+/**
+ * Average number of vertices transformed per triangle with a FIFO
+ * post-transform cache of ACMR_CACHE_SIZE entries.
+ *
+ * @param indices the triangle list
+ * @param vertexCount the number of vertices the list indexes
+ */
+float computeACMR(const std::vector<GLuint>& indices, int vertexCount);
+
+/**
+ * Runs every step on a strip mesh: strips to triangles, welding, triangle
+ * and vertex reordering.
+ *
+ * @param vertices the vertex data
+ * @param count the number of vertices
+ * @param stride the size of a vertex in bytes
+ * @param strips the strips of the mesh
+ * @param stripCount the number of strips
+ * @param[out] mesh the optimized mesh and its ACMR before and after
+ */
+void optimizeStripMesh(const void* vertices,
+                       int count,
+                       GLsizei stride,
+                       const VertexStrip* strips,
+                       int stripCount,
+                       OptimizedMesh& mesh);
+
+#endif
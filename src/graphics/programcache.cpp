@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/programcache.h>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+// Larger binaries are taken for corrupt files
+#define PROGRAM_BINARY_MAX_SIZE (64ULL * 1024 * 1024)
+
+// Header of a cache file, followed by the binary itself
+using ProgramCacheHeader = struct ProgramCacheHeader {
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    uint64_t size;
+};
+
+// FNV-1a, plenty for telling program inputs apart
+static uint64_t hashBytes(uint64_t hash, const std::string& bytes) {
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+void ProgramCache::init(const std::string& cacheDir) {
+    this->directory = cacheDir;
+
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    this->enabled = formats > 0 && !cacheDir.empty();
+
+    const GLubyte* strings[3] = {glGetString(GL_VENDOR),
+                                 glGetString(GL_RENDERER),
+                                 glGetString(GL_VERSION)};
+    for (const GLubyte* string : strings) {
+        if (string != nullptr) {
+            this->driver += (const char*)string;
+        }
+        this->driver += '\n';
+    }
+}
+
+bool ProgramCache::isEnabled() const {
+    return this->enabled;
+}
+
+std::string ProgramCache::pathOf(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof name, "%016" PRIx64 ".bin", key);
+    return this->directory + name;
+}
+
+uint64_t ProgramCache::key(const std::string& inputs) const {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    hash = hashBytes(hash, this->driver);
+    hash = hashBytes(hash, inputs);
+    return hash ^ PROGRAM_CACHE_VERSION;
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key) const {
+    if (!this->enabled) {
+        return false;
+    }
+
+    FILE* file = fopen(this->pathOf(key).c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    ProgramCacheHeader header;
+    std::vector<unsigned char> binary;
+    bool valid = fread(&header, sizeof header, 1, file) == 1 &&
+                 header.version == PROGRAM_CACHE_VERSION &&
+                 header.key == key && header.size <= PROGRAM_BINARY_MAX_SIZE;
+    if (valid) {
+        binary.resize(header.size);
+        valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (!valid) {
+        return false;
+    }
+
+    // The driver is free to refuse binaries, of an older build for example
+    glProgramBinary(program, header.format, binary.data(),
+                    (GLsizei)binary.size());
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key) const {
+    if (!this->enabled) {
+        return;
+    }
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) {
+        return;
+    }
+
+    std::vector<unsigned char> binary(size);
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &size, &format, binary.data());
+
+    ProgramCacheHeader header = {PROGRAM_CACHE_VERSION, format, key,
+                                 (uint64_t)size};
+    // Written aside and renamed, so a crash never leaves half a binary
+    std::string path = this->pathOf(key);
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    bool written = fwrite(&header, sizeof header, 1, file) == 1 &&
+                   fwrite(binary.data(), 1, size, file) == (size_t)size;
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        remove(temp.c_str());
+        return;
+    }
+    // rename does not replace existing files everywhere
+    remove(path.c_str());
+    rename(temp.c_str(), path.c_str());
+}
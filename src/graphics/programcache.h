@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_PROGRAMCACHE
+#define _HOMD_GRAPHICS_PROGRAMCACHE
+
+#define GLEW_STATIC
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+
+// Bumped whenever the layout of the cache files changes
+#define PROGRAM_CACHE_VERSION 1
+
+/**
+ * Keeps linked shader programs on disk as driver binaries, so later runs
+ * skip compiling and linking.
+ *
+ * Programs are keyed by a hash of everything that goes into them, the
+ * sources, the defines and attribute bindings, plus the GL vendor,
+ * renderer and version strings, so a driver update never sees binaries
+ * of another driver. Drivers may still reject a binary, callers then fall
+ * back to a full compile and store the new binary.
+ */
+class ProgramCache {
+    std::string directory;
+    // Vendor, renderer and version of the context, part of every key
+    std::string driver;
+    bool enabled = false;
+
+    [[nodiscard]] std::string pathOf(uint64_t key) const;
+
+   public:
+    /**
+     * Enables the cache if the context can hand out program binaries,
+     * needs a current context.
+     *
+     * @param cacheDir the directory the binaries are kept in, with a
+     * trailing separator
+     */
+    void init(const std::string& cacheDir);
+
+    [[nodiscard]] bool isEnabled() const;
+
+    /**
+     * Hashes the inputs of a program together with the driver.
+     *
+     * @param inputs the sources, defines and bindings of the program
+     */
+    [[nodiscard]] uint64_t key(const std::string& inputs) const;
+
+    /**
+     * Loads a program binary.
+     *
+     * @param program the program object to load into
+     * @param key the key of the program
+     *
+     * @return whether the program is linked and ready to use
+     */
+    bool load(GLuint program, uint64_t key) const;
+
+    /**
+     * Stores the binary of a linked program.
+     *
+     * @param program the linked program object
+     * @param key the key of the program
+     */
+    void store(GLuint program, uint64_t key) const;
+};
+
+#endif
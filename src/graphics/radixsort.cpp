@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/radixsort.h>
+#include <cstring>
+
+// Stable, and faster than the passes for a handful of items
+static void insertionSort(SortItem* items, size_t count) {
+    for (size_t i = 1; i < count; ++i) {
+        SortItem item = items[i];
+        size_t j = i;
+        while (j > 0 && items[j - 1].key > item.key) {
+            items[j] = items[j - 1];
+            --j;
+        }
+        items[j] = item;
+    }
+}
+
+void radixSort(SortItem* items, SortItem* scratch, size_t count) {
+    if (count < RADIX_SORT_MIN_ITEMS) {
+        insertionSort(items, count);
+        return;
+    }
+
+    // Histograms of all eight bytes in a single read of the keys
+    static thread_local size_t histograms[8][256];
+    memset(histograms, 0, sizeof histograms);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = items[i].key;
+        for (int byte = 0; byte < 8; ++byte) {
+            histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+        }
+    }
+
+    SortItem* from = items;
+    SortItem* to = scratch;
+    for (int byte = 0; byte < 8; ++byte) {
+        size_t* histogram = histograms[byte];
+        // Every key has the same byte here, the pass would not move anything
+        if (histogram[(from[0].key >> (byte * 8)) & 0xFF] == count) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            size_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            to[histogram[(from[i].key >> (byte * 8)) & 0xFF]++] = from[i];
+        }
+
+        SortItem* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != items) {
+        memcpy(items, from, count * sizeof(SortItem));
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_RADIXSORT
+#define _HOMD_GRAPHICS_RADIXSORT
+
+#include <cstddef>
+#include <cstdint>
+
+// Below this many items insertion sort beats the histogram passes
+#define RADIX_SORT_MIN_ITEMS 64
+
+// A sort key and the index of what it belongs to
+using SortItem = struct SortItem {
+    uint64_t key;
+    uint32_t index;
+};
+
+/**
+ * Sorts items by key, least significant byte first. Items with equal keys
+ * keep their order. Bytes every key shares are skipped, so keys that only
+ * use a few bits cost a few passes.
+ *
+ * @param[in,out] items the items to sort
+ * @param scratch room for count items
+ * @param count the number of items
+ */
+void radixSort(SortItem* items, SortItem* scratch, size_t count);
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/graphics.h>
+#include <graphics/renderqueue.h>
+#include <graphics/shader.h>
+#include <graphics/uniforms.h>
+
+// Names of the GPU zones of the passes, one per value of the pass field
+static const char* const passZoneNames[1 << SORT_KEY_PASS_BITS] = {
+    "Pass 0", "Pass 1", "Pass 2",  "Pass 3",  "Pass 4",  "Pass 5",
+    "Pass 6", "Pass 7", "Pass 8",  "Pass 9",  "Pass 10", "Pass 11",
+    "Pass 12", "Pass 13", "Pass 14", "Pass 15"};
+
+uint64_t makeSortKey(unsigned int pass,
+                     unsigned int program,
+                     unsigned int material,
+                     GLuint vertexArrayObj,
+                     float depth) {
+    const uint64_t depthMax = (1ULL << SORT_KEY_DEPTH_BITS) - 1;
+    float clamped = depth < 0.0F ? 0.0F : depth > 1.0F ? 1.0F : depth;
+
+    uint64_t key = pass & ((1U << SORT_KEY_PASS_BITS) - 1);
+    key = key << SORT_KEY_PROGRAM_BITS |
+          (program & ((1U << SORT_KEY_PROGRAM_BITS) - 1));
+    key = key << SORT_KEY_MATERIAL_BITS |
+          (material & ((1U << SORT_KEY_MATERIAL_BITS) - 1));
+    key = key << SORT_KEY_VERTEX_ARRAY_BITS |
+          (vertexArrayObj & ((1U << SORT_KEY_VERTEX_ARRAY_BITS) - 1));
+    key = key << SORT_KEY_DEPTH_BITS | (uint64_t)(clamped * depthMax);
+    return key;
+}
+
+void CommandList::draw(const DrawCommand& command,
+                       const DrawUniform* drawUniforms,
+                       int drawUniformCount) {
+    this->commands.push_back(command);
+    DrawCommand& recorded = this->commands.back();
+    recorded.firstUniform = (uint32_t)this->uniforms.size();
+    recorded.uniformCount = (uint32_t)drawUniformCount;
+    this->uniforms.insert(this->uniforms.end(), drawUniforms,
+                          drawUniforms + drawUniformCount);
+}
+
+void CommandList::clear() {
+    this->commands.clear();
+    this->uniforms.clear();
+}
+
+CommandList* RenderQueue::beginList() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->listsInUse == this->lists.size()) {
+        this->lists.push_back(std::make_unique<CommandList>());
+    }
+    return this->lists[this->listsInUse++].get();
+}
+
+void RenderQueue::execute(const UniformRing& uniforms, GpuTimer* timer) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->items.clear();
+    this->refs.clear();
+    for (size_t l = 0; l < this->listsInUse; ++l) {
+        const CommandList* list = this->lists[l].get();
+        for (size_t c = 0; c < list->commands.size(); ++c) {
+            this->items.push_back(
+                {list->commands[c].key, (uint32_t)this->refs.size()});
+            this->refs.emplace_back(list, (uint32_t)c);
+        }
+    }
+    this->scratch.resize(this->items.size());
+    radixSort(this->items.data(), this->scratch.data(), this->items.size());
+
+    // The state cache of Graphics catches the rest, this only spares it
+    // the lookups for runs of draws sharing state
+    const ShaderProgram* program = nullptr;
+    GLintptr objectBlock = -1;
+    // The pass is the top of the key, so each one is a single run of draws
+    int pass = -1;
+    int passZone = -1;
+    bool timeDraws = timer != nullptr && timer->timeDraws;
+    for (const SortItem& item : this->items) {
+        const CommandList* list = this->refs[item.index].first;
+        const DrawCommand& command =
+            list->commands[this->refs[item.index].second];
+
+        auto commandPass = (int)(item.key >> (64 - SORT_KEY_PASS_BITS));
+        if (timer != nullptr && commandPass != pass) {
+            timer->end(passZone);
+            passZone = timer->begin(passZoneNames[commandPass]);
+        }
+        pass = commandPass;
+        int drawZone = timeDraws ? timer->begin("Draw") : -1;
+
+        if (command.program != program) {
+            program = command.program;
+            Graphics::useProgram(program);
+        }
+        if (command.objectBlockSize > 0 && command.objectBlock != objectBlock) {
+            objectBlock = command.objectBlock;
+            uniforms.bind(OBJECT_BLOCK_BINDING, command.objectBlock,
+                          command.objectBlockSize);
+        }
+        for (uint32_t u = 0; u < command.uniformCount; ++u) {
+            const DrawUniform& uniform =
+                list->uniforms[command.firstUniform + u];
+            if (uniform.count == 16) {
+                Graphics::setUniformMatrixValue(uniform.location,
+                                                uniform.value);
+            } else {
+                Graphics::setUniformValue(uniform.location, uniform.value);
+            }
+        }
+
+        if (command.streams != nullptr) {
+            if (command.indexCount > 0) {
+                Graphics::drawElementsInstanced(
+                    command.vertexArrayObj, command.mode, command.indexCount,
+                    command.attrBindingIdx, command.streams,
+                    command.streamCount, command.firstInstance,
+                    command.instanceCount);
+            } else {
+                Graphics::drawArraysInstanced(
+                    command.vertexArrayObj, command.mode, command.stripCount,
+                    command.strips, command.attrBindingIdx, command.streams,
+                    command.streamCount, command.firstInstance,
+                    command.instanceCount);
+            }
+        } else if (command.indexCount > 0) {
+            Graphics::drawElements(command.vertexArrayObj, command.mode,
+                                   command.indexCount);
+        } else {
+            Graphics::drawArrays(command.vertexArrayObj, command.mode,
+                                 command.stripCount, command.strips);
+        }
+        if (timeDraws) {
+            timer->end(drawZone);
+        }
+    }
+    if (timer != nullptr) {
+        timer->end(passZone);
+    }
+
+    for (size_t l = 0; l < this->listsInUse; ++l) {
+        this->lists[l]->clear();
+    }
+    this->listsInUse = 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_RENDERQUEUE
+#define _HOMD_GRAPHICS_RENDERQUEUE
+
+#define GLEW_STATIC
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+#include <graphics/radixsort.h>
+#include <graphics/vertex.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Bits of every field of a sort key, from the most significant down
+#define SORT_KEY_PASS_BITS 4
+#define SORT_KEY_PROGRAM_BITS 12
+#define SORT_KEY_MATERIAL_BITS 16
+#define SORT_KEY_VERTEX_ARRAY_BITS 16
+#define SORT_KEY_DEPTH_BITS 16
+
+class GpuTimer;
+class ShaderProgram;
+class UniformRing;
+struct InstanceStream;
+
+// A uniform value set right before a draw
+using DrawUniform = struct DrawUniform {
+    GLint location;
+    // 4 for a vec4, 16 for a mat4
+    int count;
+    GLfloat value[16];
+};
+
+// Everything needed to issue one draw
+using DrawCommand = struct DrawCommand {
+    // Draws run in the order of their keys, see makeSortKey
+    uint64_t key;
+    const ShaderProgram* program;
+    GLuint vertexArrayObj;
+    int mode;
+    // Number of indices to draw, 0 to draw the strips instead
+    GLsizei indexCount;
+    int stripCount;
+    const VertexStrip* strips;
+    // Per-instance streams, nullptr for draws without instancing. They
+    // are read when the queue executes, not when the draw is recorded.
+    const InstanceStream* streams;
+    int streamCount;
+    int attrBindingIdx;
+    int firstInstance;
+    int instanceCount;
+    // Range of the uniform ring bound to OBJECT_BLOCK_BINDING, size 0 for
+    // none
+    GLintptr objectBlock;
+    GLsizeiptr objectBlockSize;
+    // Uniform values of the draw inside the list that recorded it, filled
+    // in by CommandList::draw
+    uint32_t firstUniform;
+    uint32_t uniformCount;
+};
+
+/**
+ * Packs the state of a draw into a sort key. Draws are grouped by pass,
+ * then program, material and vertex array, so the state changes between
+ * neighbours are the cheap ones. Within a group draws go front to back.
+ *
+ * @param pass the pass of the draw, passes run in order
+ * @param program the sort id of the program
+ * @param material the material of the draw
+ * @param vertexArrayObj the vertex array object of the draw
+ * @param depth the distance of the draw, 0 at the eye and 1 at the far
+ * plane. Pass 1 - depth to go back to front for blending.
+ */
+uint64_t makeSortKey(unsigned int pass,
+                     unsigned int program,
+                     unsigned int material,
+                     GLuint vertexArrayObj,
+                     float depth);
+
+/**
+ * Draws recorded by one thread.
+ *
+ * Lists come from RenderQueue::beginList, every thread records into its
+ * own list without any locking.
+ */
+class CommandList {
+    friend class RenderQueue;
+
+    std::vector<DrawCommand> commands;
+    std::vector<DrawUniform> uniforms;
+
+   public:
+    /**
+     * Records a draw.
+     *
+     * @param command the draw
+     * @param drawUniforms uniform values to set before the draw, copied
+     * @param drawUniformCount the number of uniform values
+     */
+    void draw(const DrawCommand& command,
+              const DrawUniform* drawUniforms = nullptr,
+              int drawUniformCount = 0);
+
+    void clear();
+};
+
+// Collects the draws of a frame and issues them sorted by key
+class RenderQueue {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<CommandList>> lists;
+    size_t listsInUse = 0;
+    // Storage of execute, kept to not reallocate every frame
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+    std::vector<std::pair<const CommandList*, uint32_t>> refs;
+
+   public:
+    // Hands out an empty list, safe to call from any thread
+    CommandList* beginList();
+
+    /**
+     * Sorts every recorded draw and issues it, skipping state that does
+     * not change between draws, then recycles the lists. Recording has to
+     * be over.
+     *
+     * @param uniforms the ring the object blocks of the draws live in
+     * @param timer times every pass on the GPU, and every draw if it asks
+     * for that, or nullptr
+     */
+    void execute(const UniformRing& uniforms, GpuTimer* timer = nullptr);
+};
+
+#endif
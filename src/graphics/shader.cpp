@@ -0,0 +1,221 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/graphics.h>
+#include <graphics/programcache.h>
+#include <graphics/shader.h>
+#include <iostream>
+#include <vector>
+
+// Sort ids handed out so far
+static uint16_t nextSortId = 0;
+
+/**
+ * Puts defines into a shader source, after the #version line since
+ * nothing may come before it.
+ *
+ * @param source the shader source
+ * @param defines the #define lines to insert
+ */
+static std::string insertDefines(const char* source,
+                                 const std::string& defines) {
+    std::string text = source;
+    size_t at = 0;
+    size_t version = text.find("#version");
+    if (version != std::string::npos) {
+        at = text.find('\n', version);
+        if (at == std::string::npos) {
+            text += '\n';
+            at = text.size();
+        } else {
+            at++;
+        }
+    }
+    text.insert(at, defines);
+    return text;
+}
+
+ShaderProgram::ShaderProgram(const ShaderDesc& desc,
+                             uint32_t variant,
+                             ProgramCache* cache) {
+    this->program = glCreateProgram();
+    this->sortId = nextSortId++;
+
+    std::string defines;
+    for (int i = 0; i < desc.defineCount; ++i) {
+        if ((variant & (1U << i)) != 0) {
+            defines += std::string("#define ") + desc.defines[i] + '\n';
+        }
+    }
+    const std::pair<GLenum, std::string> sources[2] = {
+        {GL_VERTEX_SHADER, insertDefines(desc.vertexSource, defines)},
+        {GL_FRAGMENT_SHADER, insertDefines(desc.fragmentSource, defines)},
+    };
+
+    // Everything that changes the linked program goes into the key
+    std::string inputs;
+    for (const auto& source : sources) {
+        inputs += std::to_string(source.first) + '\n' + source.second + '\0';
+    }
+    for (int i = 0; i < desc.attribCount; ++i) {
+        inputs += std::to_string(desc.attribs[i].location) + ' ' +
+                  desc.attribs[i].name + '\0';
+    }
+    uint64_t key = cache != nullptr ? cache->key(inputs) : 0;
+
+    if (cache != nullptr && cache->load(this->program, key)) {
+#ifdef DEBUG
+        std::cerr << "Program loaded from the program cache\n";
+#endif
+        this->linked = true;
+        reflect();
+        return;
+    }
+
+    for (const auto& source : sources) {
+        GLuint shader = glCreateShader(source.first);
+        const char* src = source.second.c_str();
+        glShaderSource(shader, 1, &src, nullptr);
+        glCompileShader(shader);
+        glAttachShader(this->program, shader);
+#ifdef DEBUG
+        char msg[512];
+        glGetShaderInfoLog(shader, sizeof msg, nullptr, msg);
+        std::cerr << "Shader info: " << msg << "\n";
+#endif
+        // Only deleted once the program lets go of it
+        glDeleteShader(shader);
+    }
+    for (int i = 0; i < desc.attribCount; ++i) {
+        glBindAttribLocation(this->program, desc.attribs[i].location,
+                             desc.attribs[i].name);
+    }
+
+    if (cache != nullptr && cache->isEnabled()) {
+        glProgramParameteri(this->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                            GL_TRUE);
+    }
+    glLinkProgram(this->program);
+#ifdef DEBUG
+    char msg[512];
+    glGetProgramInfoLog(this->program, sizeof msg, nullptr, msg);
+    std::cerr << "Program info: " << msg << "\n";
+#endif
+
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(this->program, GL_LINK_STATUS, &linkStatus);
+    this->linked = linkStatus == GL_TRUE;
+    if (!this->linked) {
+        return;
+    }
+    if (cache != nullptr) {
+        cache->store(this->program, key);
+    }
+    reflect();
+}
+
+ShaderProgram::~ShaderProgram() {
+    Graphics::deleteProgram(this->program);
+}
+
+void ShaderProgram::reflect() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(this->program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(this->program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength > 0 ? maxLength : 1);
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(this->program, i, (GLsizei)name.size(), &length,
+                           &size, &type, name.data());
+        GLint location = glGetUniformLocation(this->program, name.data());
+        // Members of uniform blocks have no location
+        if (location < 0) {
+            continue;
+        }
+        std::string uniform(name.data(), length);
+        // Arrays are reported as name[0], allow asking for just the name
+        if (uniform.size() > 3 &&
+            uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+            this->uniformLocs[uniform.substr(0, uniform.size() - 3)] =
+                location;
+        }
+        this->uniformLocs[uniform] = location;
+    }
+
+    if (!Graphics::supportsUniformBuffers()) {
+        return;
+    }
+    count = 0;
+    maxLength = 0;
+    glGetProgramiv(this->program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(this->program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH,
+                   &maxLength);
+    name.resize(maxLength > 0 ? maxLength : 1);
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(this->program, i, (GLsizei)name.size(),
+                                    &length, name.data());
+        this->blockIndices[std::string(name.data(), length)] = i;
+    }
+}
+
+GLuint ShaderProgram::getId() const {
+    return this->program;
+}
+
+uint16_t ShaderProgram::getSortId() const {
+    return this->sortId;
+}
+
+bool ShaderProgram::isLinked() const {
+    return this->linked;
+}
+
+GLint ShaderProgram::getUniformLoc(const char* name) const {
+    auto found = this->uniformLocs.find(name);
+    return found != this->uniformLocs.end() ? found->second : -1;
+}
+
+void ShaderProgram::bindUniformBlock(const char* name,
+                                     GLuint bindingPoint) const {
+    auto found = this->blockIndices.find(name);
+    if (found != this->blockIndices.end()) {
+        glUniformBlockBinding(this->program, found->second, bindingPoint);
+    }
+}
+
+void ShaderVariants::init(const ShaderDesc& shaderDesc,
+                          ProgramCache* programCache) {
+    this->desc = shaderDesc;
+    this->cache = programCache;
+}
+
+ShaderProgram* ShaderVariants::get(uint32_t variant) {
+    auto& program = this->programs[variant];
+    if (program == nullptr) {
+        program =
+            std::make_unique<ShaderProgram>(this->desc, variant, this->cache);
+    }
+    return program.get();
+}
+
+void ShaderVariants::release() {
+    this->programs.clear();
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_SHADER
+#define _HOMD_GRAPHICS_SHADER
+
+#define GLEW_STATIC
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class ProgramCache;
+
+// Attribute location bound to a name before linking
+using ShaderAttrib = struct ShaderAttrib {
+    GLuint location;
+    const char* name;
+};
+
+// Everything a program is built from. Variants of the program turn on a
+// subset of the defines, bit i of a variant turns on defines[i].
+using ShaderDesc = struct ShaderDesc {
+    const char* vertexSource;
+    const char* fragmentSource;
+    const ShaderAttrib* attribs;
+    int attribCount;
+    const char* const* defines;
+    int defineCount;
+};
+
+/**
+ * A linked shader program.
+ *
+ * The locations of the uniforms and the indices of the uniform blocks are
+ * looked up once after linking, asking for them later does not reach GL.
+ */
+class ShaderProgram {
+    GLuint program;
+    // Dense id in creation order, draws sorted by it switch programs the
+    // least
+    uint16_t sortId;
+    bool linked = false;
+    std::unordered_map<std::string, GLint> uniformLocs;
+    std::unordered_map<std::string, GLuint> blockIndices;
+
+    // Caches the uniform locations and block indices of the program
+    void reflect();
+
+   public:
+    /**
+     * Builds a program, from the program cache when possible.
+     *
+     * @param desc the sources and attribute bindings
+     * @param variant the defines to turn on
+     * @param cache the program cache, or nullptr
+     */
+    ShaderProgram(const ShaderDesc& desc,
+                  uint32_t variant,
+                  ProgramCache* cache);
+    ~ShaderProgram();
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    [[nodiscard]] GLuint getId() const;
+    [[nodiscard]] uint16_t getSortId() const;
+    [[nodiscard]] bool isLinked() const;
+
+    // Location of a uniform, -1 if the program does not use it
+    [[nodiscard]] GLint getUniformLoc(const char* name) const;
+
+    /**
+     * Assigns a uniform block of the program to a binding point.
+     *
+     * @param name the name of the uniform block
+     * @param bindingPoint the binding point to read the block from
+     */
+    void bindUniformBlock(const char* name, GLuint bindingPoint) const;
+};
+
+// The variants of a program, built the first time they are asked for
+class ShaderVariants {
+    ShaderDesc desc = {};
+    ProgramCache* cache = nullptr;
+    std::unordered_map<uint32_t, std::unique_ptr<ShaderProgram>> programs;
+
+   public:
+    ShaderVariants() = default;
+    ~ShaderVariants() = default;
+
+    /**
+     * @param shaderDesc the sources and defines of the variants, the
+     * strings have to outlive the variants
+     * @param programCache the program cache, or nullptr
+     */
+    void init(const ShaderDesc& shaderDesc, ProgramCache* programCache);
+
+    /**
+     * Gets a variant of the program.
+     *
+     * @param variant the defines to turn on, bit i for desc.defines[i]
+     */
+    ShaderProgram* get(uint32_t variant = 0);
+
+    // Deletes every variant built so far
+    void release();
+};
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/graphics.h>
+#include <graphics/stream.h>
+
+// How long to wait on a fence at a time, in nanoseconds
+#define FENCE_TIMEOUT 1000000
+
+void StreamBuffer::init(GLenum bufTarget, GLsizeiptr size) {
+    this->target = bufTarget;
+    this->frameSize = size;
+    this->persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    create();
+}
+
+void StreamBuffer::create() {
+    glGenBuffers(1, &this->bufObj);
+    Graphics::bindBuffer(this->target, this->bufObj);
+
+    if (this->persistent) {
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(this->target, this->frameSize * STREAM_FRAMES,
+                        nullptr, flags);
+        this->mapped = (unsigned char*)glMapBufferRange(
+            this->target, 0, this->frameSize * STREAM_FRAMES, flags);
+    } else {
+        glBufferData(this->target, this->frameSize, nullptr, GL_STREAM_DRAW);
+        this->staging.resize(this->frameSize);
+    }
+}
+
+void StreamBuffer::destroy() {
+    for (auto& fence : this->fences) {
+        if (fence != nullptr) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                             GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    Graphics::bindBuffer(this->target, this->bufObj);
+    if (this->mapped != nullptr) {
+        glUnmapBuffer(this->target);
+        this->mapped = nullptr;
+    }
+    glDeleteBuffers(1, &this->bufObj);
+    Graphics::bindBuffer(this->target, 0);
+    this->bufObj = 0;
+}
+
+StreamAlloc StreamBuffer::alloc(GLsizeiptr size, GLintptr alignment) {
+    GLsizeiptr offset = (this->head + alignment - 1) / alignment * alignment;
+    if (offset + size > this->frameSize) {
+        // Grow for the coming frames, moving the buffer now would leave
+        // the earlier allocations of this frame dangling
+        if (offset + size > this->wanted) {
+            this->wanted = offset + size;
+        }
+        return StreamAlloc{nullptr, 0, 0};
+    }
+    this->head = offset + size;
+
+    if (this->persistent) {
+        GLintptr base = (GLintptr)this->frame * this->frameSize;
+        return StreamAlloc{this->mapped + base + offset, this->bufObj,
+                           base + offset};
+    }
+    return StreamAlloc{this->staging.data() + offset, this->bufObj, offset};
+}
+
+void StreamBuffer::flush() {
+    // Coherent mappings are visible to the GPU as they are written
+    if (this->persistent || this->flushed == this->head) {
+        return;
+    }
+
+    Graphics::bindBuffer(this->target, this->bufObj);
+    if (this->flushed == 0) {
+        // First upload of the frame, orphan the storage the GPU may still
+        // be reading from
+        glBufferData(this->target, this->frameSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(this->target, this->flushed, this->head - this->flushed,
+                    this->staging.data() + this->flushed);
+    this->flushed = this->head;
+}
+
+void StreamBuffer::endFrame() {
+    this->head = 0;
+    this->flushed = 0;
+
+    if (this->wanted > this->frameSize) {
+        destroy();
+        while (this->frameSize < this->wanted) {
+            this->frameSize *= 2;
+        }
+        create();
+        this->frame = 0;
+        return;
+    }
+    if (!this->persistent) {
+        return;
+    }
+
+    this->fences[this->frame] =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    this->frame = (this->frame + 1) % STREAM_FRAMES;
+
+    GLsync& fence = this->fences[this->frame];
+    if (fence != nullptr) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_STREAM
+#define _HOMD_GRAPHICS_STREAM
+
+#define GLEW_STATIC
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+#include <vector>
+
+// Number of frames the CPU may run ahead of the GPU
+#define STREAM_FRAMES 3
+
+// A piece of the stream buffer handed out for the current frame
+using StreamAlloc = struct StreamAlloc {
+    // Where to write the data, valid until the end of the frame
+    void* data;
+    // The buffer object to bind for drawing
+    GLuint bufObj;
+    // Offset of the data inside the buffer object
+    GLintptr offset;
+};
+
+/**
+ * Buffer for data that changes every frame, such as dynamic geometry,
+ * instance data or uniform blocks.
+ *
+ * The buffer is split into STREAM_FRAMES regions. Each frame writes into
+ * its own region through a persistent coherent mapping and a fence makes
+ * sure the GPU is done with a region before it is handed out again. On
+ * contexts without ARB_buffer_storage the data is staged on the CPU and
+ * uploaded into an orphaned buffer instead.
+ */
+class StreamBuffer {
+    GLenum target = GL_ARRAY_BUFFER;
+    GLuint bufObj = 0;
+    // Size of a single frame region
+    GLsizeiptr frameSize = 0;
+    // Region of the current frame
+    int frame = 0;
+    // Bytes handed out in the current frame
+    GLsizeiptr head = 0;
+    // Bytes already uploaded, only used without persistent mapping
+    GLsizeiptr flushed = 0;
+    // Largest frame asked for, the buffer grows to it at the end of frame
+    GLsizeiptr wanted = 0;
+    bool persistent = false;
+    unsigned char* mapped = nullptr;
+    std::vector<unsigned char> staging;
+    GLsync fences[STREAM_FRAMES] = {};
+
+    void create();
+
+   public:
+    StreamBuffer() = default;
+    ~StreamBuffer() = default;
+
+    /**
+     * Creates the buffer, needs a current context.
+     *
+     * @param bufTarget the binding target the buffer is used with
+     * @param size the number of bytes a single frame can use
+     */
+    void init(GLenum bufTarget, GLsizeiptr size);
+
+    /**
+     * Hands out memory for the current frame.
+     *
+     * When the frame runs out of space data is nullptr and the caller has
+     * to upload some other way, the buffer grows to fit from the next
+     * frame on.
+     *
+     * @param size the number of bytes needed
+     * @param alignment what the offset has to be a multiple of
+     */
+    StreamAlloc alloc(GLsizeiptr size, GLintptr alignment = 16);
+
+    // Makes everything written so far visible to the GPU, call before the
+    // draws that read it
+    void flush();
+
+    // Fences the current region and moves on to the next one, waiting if
+    // the GPU still reads from it
+    void endFrame();
+
+    // Unmaps and deletes the buffer, waiting for the GPU to finish with it
+    void destroy();
+};
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/culling.h>
+#include <graphics/transform.h>
+#include <jobs/jobs.h>
+#include <cmath>
+
+// Below this many objects a job costs more than it saves
+#define MIN_OBJECTS_PER_JOB 1024
+
+int TransformBatch::add(float x, float y, float z, float rad, int parentIdx) {
+    this->posX.push_back(x);
+    this->posY.push_back(y);
+    this->posZ.push_back(z);
+    this->angle.push_back(rad);
+    this->parent.push_back(parentIdx);
+    this->radius.push_back(0.0F);
+    return (int)this->posX.size() - 1;
+}
+
+void TransformBatch::resize(int count) {
+    this->posX.resize(count, 0.0F);
+    this->posY.resize(count, 0.0F);
+    this->posZ.resize(count, 0.0F);
+    this->angle.resize(count, 0.0F);
+    this->parent.resize(count, 0);
+    this->radius.resize(count, 0.0F);
+}
+
+int TransformBatch::size() const {
+    return (int)this->posX.size();
+}
+
+const ObjectTransform* TransformBatch::data() const {
+    return this->output.data();
+}
+
+const std::vector<int>& TransformBatch::visible() const {
+    return this->visibleObjects;
+}
+
+int TransformBatch::cull(const Mat4& projection) {
+    int count = this->size();
+    this->visibleFlags.resize(count);
+    this->visibleObjects.clear();
+
+    // Positions are relative to the parent, so are the planes of the
+    // frustum of projection * parent
+    if (this->parents.size() == 1) {
+        Frustum frustum = extractFrustum((projection * this->parents[0]).m);
+        cullSpheres(frustum, this->posX.data(), this->posY.data(),
+                    this->posZ.data(), this->radius.data(), count,
+                    this->visibleFlags.data());
+    } else {
+        cullByParent(projection);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (this->visibleFlags[i] != 0) {
+            this->visibleObjects.push_back(i);
+        }
+    }
+    return (int)this->visibleObjects.size();
+}
+
+void TransformBatch::cullByParent(const Mat4& projection) {
+    int count = this->size();
+    auto parentCount = (int)this->parents.size();
+    CullScratch& scratch = this->cullScratch;
+
+    // Counting sort by parent, so every parent tests a contiguous run of
+    // its own objects only
+    scratch.first.assign(parentCount + 1, 0);
+    for (int i = 0; i < count; ++i) {
+        ++scratch.first[this->parent[i] + 1];
+    }
+    for (int p = 0; p < parentCount; ++p) {
+        scratch.first[p + 1] += scratch.first[p];
+    }
+
+    scratch.order.resize(count);
+    scratch.x.resize(count);
+    scratch.y.resize(count);
+    scratch.z.resize(count);
+    scratch.radius.resize(count);
+    scratch.flags.resize(count);
+    scratch.next.assign(scratch.first.begin(), scratch.first.end() - 1);
+    for (int i = 0; i < count; ++i) {
+        int slot = scratch.next[this->parent[i]]++;
+        scratch.order[slot] = i;
+        scratch.x[slot] = this->posX[i];
+        scratch.y[slot] = this->posY[i];
+        scratch.z[slot] = this->posZ[i];
+        scratch.radius[slot] = this->radius[i];
+    }
+
+    for (int p = 0; p < parentCount; ++p) {
+        int begin = scratch.first[p];
+        int runLength = scratch.first[p + 1] - begin;
+        if (runLength == 0) {
+            continue;
+        }
+        Frustum frustum = extractFrustum((projection * this->parents[p]).m);
+        cullSpheres(frustum, scratch.x.data() + begin,
+                    scratch.y.data() + begin, scratch.z.data() + begin,
+                    scratch.radius.data() + begin, runLength,
+                    scratch.flags.data() + begin);
+    }
+
+    for (int slot = 0; slot < count; ++slot) {
+        this->visibleFlags[scratch.order[slot]] = scratch.flags[slot];
+    }
+}
+
+void TransformBatch::compute(const Mat4& projection, JobSystem* jobs) {
+    int count = this->size();
+
+    this->parentsProj.resize(this->parents.size());
+    for (size_t i = 0; i < this->parents.size(); ++i) {
+        Mat4::mul(this->parentsProj[i].m, projection.m, this->parents[i].m);
+    }
+
+    // Separate pass so the compiler can vectorize the trigonometry
+    this->sinAngle.resize(count);
+    this->cosAngle.resize(count);
+    this->output.resize(count);
+    const float* rad = this->angle.data();
+    float* sinOut = this->sinAngle.data();
+    float* cosOut = this->cosAngle.data();
+    for (int i = 0; i < count; ++i) {
+        sinOut[i] = std::sin(rad[i]);
+        cosOut[i] = std::cos(rad[i]);
+    }
+
+    if (jobs == nullptr) {
+        computeRange(0, count);
+        return;
+    }
+    jobs->parallelFor(0, count, MIN_OBJECTS_PER_JOB,
+                      [this](int begin, int end) { computeRange(begin, end); });
+}
+
+void TransformBatch::computeRange(int begin, int end) {
+    const float* px = this->posX.data();
+    const float* py = this->posY.data();
+    const float* pz = this->posZ.data();
+    const float* sn = this->sinAngle.data();
+    const float* cs = this->cosAngle.data();
+    const int* parentIdx = this->parent.data();
+
+    for (int i = begin; i < end; ++i) {
+        const float* p = this->parents[parentIdx[i]].m;
+        const float* q = this->parentsProj[parentIdx[i]].m;
+        float* mvp = this->output[i].modelViewProjection.m;
+        float* n = this->output[i].normal.m;
+        float s = sn[i];
+        float c = cs[i];
+        float x = px[i];
+        float y = py[i];
+        float z = pz[i];
+        float mv[16];
+
+        // T(x, y, z) * Rz(angle) only mixes the first two columns and
+        // moves the translation, so the full products are not needed.
+        for (int r = 0; r < 4; ++r) {
+            mv[r] = c * p[r] + s * p[4 + r];
+            mv[4 + r] = c * p[4 + r] - s * p[r];
+            mv[8 + r] = p[8 + r];
+            mv[12 + r] = x * p[r] + y * p[4 + r] + z * p[8 + r] + p[12 + r];
+
+            mvp[r] = c * q[r] + s * q[4 + r];
+            mvp[4 + r] = c * q[4 + r] - s * q[r];
+            mvp[8 + r] = q[8 + r];
+            mvp[12 + r] = x * q[r] + y * q[4 + r] + z * q[8 + r] + q[12 + r];
+        }
+
+        // The normal matrix is the inverse transpose of the model view,
+        // for a rigid transform that keeps the rotation and moves
+        // -transpose(R) * t into the bottom row.
+        for (int col = 0; col < 3; ++col) {
+            n[col * 4] = mv[col * 4];
+            n[col * 4 + 1] = mv[col * 4 + 1];
+            n[col * 4 + 2] = mv[col * 4 + 2];
+            n[col * 4 + 3] = -(mv[col * 4] * mv[12] +
+                               mv[col * 4 + 1] * mv[13] +
+                               mv[col * 4 + 2] * mv[14]);
+        }
+        n[12] = 0.0F;
+        n[13] = 0.0F;
+        n[14] = 0.0F;
+        n[15] = 1.0F;
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_TRANSFORM
+#define _HOMD_GRAPHICS_TRANSFORM
+
+#include <math/mat4.h>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Matrices a shader needs to draw one object, laid out back to back so the
+// whole batch can be uploaded to a buffer object at once.
+struct ObjectTransform {
+    Mat4 modelViewProjection;
+    Mat4 normal;
+};
+
+/**
+ * Computes the model view projection and normal matrices of many objects
+ * in one pass.
+ *
+ * Every object is placed with modelView = parent * T(x, y, z) * Rz(angle),
+ * parents being rigid transforms such as the view matrix. The inputs are
+ * kept in structure-of-arrays layout so scenes can update positions and
+ * angles without touching the rest.
+ */
+class TransformBatch {
+    // projection * parent, refreshed on every compute
+    std::vector<Mat4> parentsProj;
+    std::vector<float> sinAngle;
+    std::vector<float> cosAngle;
+    std::vector<ObjectTransform> output;
+    // Results of the last cull
+    std::vector<uint8_t> visibleFlags;
+    std::vector<int> visibleObjects;
+
+    // Objects grouped by parent for culling, kept between frames
+    using CullScratch = struct CullScratch {
+        // Where the objects of every parent start, one more entry than
+        // parents
+        std::vector<int> first;
+        // Next free slot of every parent while sorting
+        std::vector<int> next;
+        // Object index of every slot
+        std::vector<int> order;
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+        std::vector<uint8_t> flags;
+    };
+    CullScratch cullScratch;
+
+    void computeRange(int begin, int end);
+    // Culls every object against the frustum of its own parent only
+    void cullByParent(const Mat4& projection);
+
+   public:
+    // Parent transforms objects are placed relative to
+    std::vector<Mat4> parents;
+    // Per object inputs
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> posZ;
+    // Rotation around the z axis in radians
+    std::vector<float> angle;
+    // Index into parents
+    std::vector<int> parent;
+    // Radius of a sphere around the object position holding the whole
+    // object however it is rotated, see boundsRadiusAroundOrigin
+    std::vector<float> radius;
+
+    /**
+     * Appends an object to the batch.
+     *
+     * @param x the x pos of the object
+     * @param y the y pos of the object
+     * @param z the z pos of the object
+     * @param rad the rotation angle around the z axis in radians
+     * @param parentIdx the index of the parent transform
+     *
+     * @return the index of the object
+     */
+    int add(float x, float y, float z, float rad, int parentIdx = 0);
+
+    /**
+     * Resizes the per object inputs, new objects sit at the origin of the
+     * first parent.
+     *
+     * @param count the number of objects
+     */
+    void resize(int count);
+
+    [[nodiscard]] int size() const;
+
+    /**
+     * Computes the matrices of every object.
+     *
+     * @param projection the projection matrix
+     * @param jobs the job system to split the batch across, nullptr to
+     * compute it on the calling thread
+     */
+    void compute(const Mat4& projection, JobSystem* jobs = nullptr);
+
+    /**
+     * The results of the last compute, one entry per object.
+     */
+    [[nodiscard]] const ObjectTransform* data() const;
+
+    /**
+     * Finds the objects whose bounding spheres touch the view frustum.
+     *
+     * @param projection the projection matrix
+     *
+     * @return the number of visible objects
+     */
+    int cull(const Mat4& projection);
+
+    // Indices of the objects the last cull found visible, in order
+    [[nodiscard]] const std::vector<int>& visible() const;
+};
+
+#endif
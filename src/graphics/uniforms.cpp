@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/graphics.h>
+#include <graphics/uniforms.h>
+#include <cstring>
+
+// Bytes of uniform data a frame can use before the stream buffer grows
+#define UNIFORM_STREAM_SIZE (256 * 1024)
+
+void UniformRing::init() {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->alignment);
+    if (this->alignment <= 0) {
+        this->alignment = 256;
+    }
+    this->stream.init(GL_UNIFORM_BUFFER, UNIFORM_STREAM_SIZE);
+}
+
+GLintptr UniformRing::push(const void* data, GLsizeiptr size) {
+    // Every block has to start at a multiple of the offset alignment
+    GLintptr offset = (GLintptr)this->staging.size();
+    offset = (offset + this->alignment - 1) / this->alignment * this->alignment;
+
+    this->staging.resize(offset + size);
+    memcpy(this->staging.data() + offset, data, size);
+    return offset;
+}
+
+void UniformRing::upload() {
+    auto size = (GLsizeiptr)this->staging.size();
+    if (size == 0) {
+        return;
+    }
+
+    StreamAlloc dest = this->stream.alloc(size, this->alignment);
+    if (dest.data != nullptr) {
+        memcpy(dest.data, this->staging.data(), size);
+        this->stream.flush();
+        this->uploadBufObj = dest.bufObj;
+        this->uploadOffset = dest.offset;
+    } else {
+        Graphics::uploadBuffer(this->overflowBufObj, GL_UNIFORM_BUFFER, size,
+                               this->staging.data());
+        this->uploadBufObj = this->overflowBufObj;
+        this->uploadOffset = 0;
+    }
+}
+
+void UniformRing::bind(GLuint bindingPoint,
+                       GLintptr offset,
+                       GLsizeiptr size) const {
+    Graphics::bindBufferRange(GL_UNIFORM_BUFFER, bindingPoint,
+                              this->uploadBufObj, this->uploadOffset + offset,
+                              size);
+}
+
+void UniformRing::endFrame() {
+    this->staging.clear();
+    this->stream.endFrame();
+}
+
+void UniformRing::release() {
+    this->stream.destroy();
+    glDeleteBuffers(1, &this->overflowBufObj);
+    this->overflowBufObj = 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_UNIFORMS
+#define _HOMD_GRAPHICS_UNIFORMS
+
+#define GLEW_STATIC
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+#include <graphics/stream.h>
+#include <graphics/transform.h>
+#include <math/mat4.h>
+#include <vector>
+
+// Binding points of the engine wide uniform blocks
+#define FRAME_BLOCK_BINDING 0
+#define OBJECT_BLOCK_BINDING 1
+
+// std140 layout of the FrameBlock uniform block, set once per frame
+using FrameUniforms = struct FrameUniforms {
+    Mat4 view;
+    Mat4 projection;
+    GLfloat lightSourcePos[4];
+};
+
+// std140 layout of the ObjectBlock uniform block, set once per draw
+using ObjectUniforms = struct ObjectUniforms {
+    ObjectTransform transform;
+    GLfloat materialColor[4];
+};
+
+/**
+ * Ring of uniform block data for a frame.
+ *
+ * Blocks are pushed into a CPU side staging area while the frame is being
+ * built, then everything goes up to the GPU in a single write into the
+ * stream buffer and every draw binds its own range of it.
+ */
+class UniformRing {
+    StreamBuffer stream;
+    GLint alignment = 256;
+    std::vector<unsigned char> staging;
+    // Where upload put the staging area
+    GLuint uploadBufObj = 0;
+    GLintptr uploadOffset = 0;
+    // Used when a frame does not fit in the stream buffer
+    GLuint overflowBufObj = 0;
+
+   public:
+    UniformRing() = default;
+    ~UniformRing() = default;
+
+    // Queries the offset alignment and creates the stream buffer, needs a
+    // current context
+    void init();
+
+    /**
+     * Copies a block into the staging area.
+     *
+     * @param data the block data
+     * @param size the size of the block in bytes
+     *
+     * @return the offset of the block inside the buffer
+     */
+    GLintptr push(const void* data, GLsizeiptr size);
+
+    // Uploads everything pushed since the last end of frame
+    void upload();
+
+    /**
+     * Binds a pushed block to a uniform block binding point.
+     *
+     * @param bindingPoint the binding point of the uniform block
+     * @param offset the offset push returned
+     * @param size the size of the block in bytes
+     */
+    void bind(GLuint bindingPoint, GLintptr offset, GLsizeiptr size) const;
+
+    // Starts over for a new frame
+    void endFrame();
+
+    // Deletes the stream and overflow buffers
+    void release();
+};
+
+#endif
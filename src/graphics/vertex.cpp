@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/vertex.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+GLushort packHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof bits);
+
+    auto sign = (uint32_t)((bits >> 16) & 0x8000U);
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFU;
+
+    // NaN and infinity
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return (GLushort)(sign | 0x7C00U | (mantissa != 0 ? 0x200U : 0));
+    }
+    // Too large, saturate to infinity
+    if (exponent >= 31) {
+        return (GLushort)(sign | 0x7C00U);
+    }
+    // Too small even for a denormal
+    if (exponent < -10) {
+        return (GLushort)sign;
+    }
+
+    uint32_t shift = 13;
+    if (exponent <= 0) {
+        // Denormal, make the implicit one explicit and shift it down
+        mantissa |= 0x800000U;
+        shift = 14 - exponent;
+        exponent = 0;
+    }
+
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1U << shift) - 1);
+    uint32_t halfway = 1U << (shift - 1);
+    half |= (uint32_t)exponent << 10;
+    // Round to nearest even, a carry into the exponent is still correct
+    if (rest > halfway || (rest == halfway && (half & 1U) != 0)) {
+        half++;
+    }
+    return (GLushort)(sign | half);
+}
+
+float unpackHalf(GLushort half) {
+    uint32_t sign = (uint32_t)(half & 0x8000U) << 16;
+    uint32_t exponent = (half >> 10) & 0x1FU;
+    uint32_t mantissa = half & 0x3FFU;
+    uint32_t bits;
+
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000U | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Denormal, renormalize it for the float
+        exponent = 127 - 15 + 1;
+        while ((mantissa & 0x400U) == 0) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FFU) << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+// Converts a component in [-1, 1] to a 10 bit signed integer
+static GLuint packSnorm10(float value) {
+    if (value > 1.0F) {
+        value = 1.0F;
+    } else if (value < -1.0F) {
+        value = -1.0F;
+    }
+    auto scaled = (int)std::lround(value * 511.0F);
+    return (GLuint)scaled & 0x3FFU;
+}
+
+GLuint packNormal(float x, float y, float z) {
+    return packSnorm10(x) | (packSnorm10(y) << 10) | (packSnorm10(z) << 20);
+}
+
+void unpackNormal(GLuint packed, float out[3]) {
+    for (int i = 0; i < 3; ++i) {
+        int value = (int)((packed >> (i * 10)) & 0x3FFU);
+        // Sign extend the 10 bit integer
+        if (value >= 512) {
+            value -= 1024;
+        }
+        // GL 4.2 and later map -512 and -511 both to -1
+        float unpacked = (float)value / 511.0F;
+        out[i] = unpacked < -1.0F ? -1.0F : unpacked;
+    }
+}
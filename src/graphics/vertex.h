@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_GRAPHICS_VERTEX
+#define _HOMD_GRAPHICS_VERTEX
+
+#define GLEW_STATIC
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+
+// Struct describing the vertices in triangle strip
+using VertexStrip = struct VertexStrip {
+    // First vertex in the strip
+    GLint first;
+    // Number of consecutive verices in the strip after the first
+    GLint count;
+};
+
+// Struct describing one attribute inside a vertex
+using VertexAttrib = struct VertexAttrib {
+    // Attribute location in the shader
+    GLuint location;
+    // Number of components
+    GLint size;
+    // Component type, such as GL_FLOAT, GL_HALF_FLOAT or
+    // GL_INT_2_10_10_10_REV
+    GLenum type;
+    // Whether integer components are mapped to [-1, 1] or [0, 1]
+    GLboolean normalized;
+    // Offset of the attribute from the start of the vertex
+    GLuint offset;
+};
+
+// Struct describing how the attributes of a vertex buffer are laid out
+using VertexLayout = struct VertexLayout {
+    const VertexAttrib* attribs;
+    int attribCount;
+    // Distance between two vertices in bytes
+    GLsizei stride;
+};
+
+/**
+ * Converts a float to a half float, rounding to nearest even.
+ *
+ * @param value the float to convert
+ *
+ * @return the bits of the half float
+ */
+GLushort packHalf(float value);
+
+/**
+ * Converts a half float back to a float.
+ *
+ * @param half the bits of the half float
+ */
+float unpackHalf(GLushort half);
+
+/**
+ * Packs a unit vector into GL_INT_2_10_10_10_REV, to be read back as a
+ * normalized attribute. The w component is left 0.
+ *
+ * @param x the x component
+ * @param y the y component
+ * @param z the z component
+ */
+GLuint packNormal(float x, float y, float z);
+
+/**
+ * Unpacks a vector packed by packNormal the way the GL does.
+ *
+ * @param packed the packed vector
+ * @param[out] out the x, y and z components
+ */
+void unpackNormal(GLuint packed, float out[3]);
+
+#endif
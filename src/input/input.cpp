@@ -18,12 +18,15 @@
 #include <SDL2/SDL_keyboard.h>
 #include <game/game.h>
 #include <input/input.h>
+#include <profile/profiler.h>
+#include <cstring>
 
 Input::Input(Game* pGame) {
     this->game = pGame;
 }
 
 bool Input::pollEvent() {
+    PROFILE_ZONE("Input::pollEvent");
     while (SDL_PollEvent(&this->event)) {
         switch (event.type) {
             case SDL_QUIT:
@@ -37,5 +40,10 @@ bool Input::pollEvent() {
 }
 
 void Input::pollKeys() {
-    this->keys = SDL_GetKeyboardState(nullptr);
+    int count = 0;
+    const Uint8* state = SDL_GetKeyboardState(&count);
+    if (count > SDL_NUM_SCANCODES) {
+        count = SDL_NUM_SCANCODES;
+    }
+    memcpy(this->keyState, state, count);
 }
\ No newline at end of file
@@ -26,12 +26,16 @@ class Game;
 class Input {
     Game* game = nullptr;
     SDL_Event event;
+    // Copy of the keyboard state, so scenes updating on another thread do
+    // not read it while SDL writes it
+    Uint8 keyState[SDL_NUM_SCANCODES] = {};
 
    public:
     Input(Game*);
     ~Input() = default;
-    const Uint8* keys;
+    const Uint8* keys = keyState;
     bool pollEvent();
+    // Takes a snapshot of the keyboard state into keys
     void pollKeys();
 };
 
@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <jobs/jobs.h>
+#include <profile/profiler.h>
+
+// Which system and queue the calling thread works for, outside threads
+// are not bound to any
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local int currentQueue = -1;
+
+JobCounter::~JobCounter() {
+    // Lets a finishing job release the lock before the counter goes away
+    std::lock_guard<std::mutex> lock(this->mutex);
+}
+
+bool JobCounter::done() const {
+    return this->value.load(std::memory_order_acquire) == 0;
+}
+
+JobSystem::JobSystem(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = (int)std::thread::hardware_concurrency();
+    }
+    if (threadCount <= 0) {
+        threadCount = 1;
+    }
+
+    // The waiting thread is the last runner, it has no worker of its own
+    this->queues = std::vector<Queue>(threadCount);
+    for (int i = 0; i < threadCount - 1; ++i) {
+        this->workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->quit = true;
+    }
+    this->wake.notify_all();
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+}
+
+int JobSystem::threadCount() const {
+    return (int)this->queues.size();
+}
+
+int JobSystem::queueIndex() const {
+    if (currentSystem == this) {
+        return currentQueue;
+    }
+    return (int)this->queues.size() - 1;
+}
+
+void JobSystem::push(Job job) {
+    Queue& queue = this->queues[this->queueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    this->pending.fetch_add(1, std::memory_order_release);
+
+    // Taking the lock orders the wake up after a worker checked pending
+    { std::lock_guard<std::mutex> lock(this->sleepMutex); }
+    this->wake.notify_one();
+}
+
+bool JobSystem::take(int index, Job& job) {
+    int count = (int)this->queues.size();
+
+    // Newest job of the own queue first, it is the most likely in cache
+    {
+        Queue& own = this->queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            this->pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Oldest job of someone else, it tends to be the biggest piece left
+    for (int i = 1; i < count; ++i) {
+        Queue& victim = this->queues[(index + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            this->pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::finish(JobCounter* counter) {
+    if (counter == nullptr) {
+        return;
+    }
+
+    // The counter is not touched after the lock is released, a waiter
+    // may destroy it right away
+    std::vector<Job> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready.swap(counter->continuations);
+        }
+    }
+    for (auto& job : ready) {
+        this->push(std::move(job));
+    }
+}
+
+void JobSystem::workerLoop(int index) {
+    currentSystem = this;
+    currentQueue = index;
+    PROFILE_THREAD("Job worker");
+
+    Job job;
+    while (true) {
+        for (int i = 0; i < JOB_SPIN_ROUNDS && this->take(index, job); ++i) {
+            PROFILE_ZONE("Job");
+            job.function();
+            this->finish(job.counter);
+        }
+
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        this->wake.wait(lock, [this] {
+            return this->quit ||
+                   this->pending.load(std::memory_order_acquire) > 0;
+        });
+        if (this->quit) {
+            return;
+        }
+    }
+}
+
+void JobSystem::run(std::function<void()> function,
+                    JobCounter* counter,
+                    JobCounter* after) {
+    if (counter != nullptr) {
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+    }
+    Job job = {std::move(function), counter};
+
+    if (after != nullptr) {
+        std::lock_guard<std::mutex> lock(after->mutex);
+        // finish drops the counter and drains the continuations under the
+        // same lock, so a job added here is never left behind
+        if (!after->done()) {
+            after->continuations.push_back(std::move(job));
+            return;
+        }
+    }
+    this->push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter* counter) {
+    int index = this->queueIndex();
+    Job job;
+    while (!counter->done()) {
+        if (this->take(index, job)) {
+            job.function();
+            this->finish(job.counter);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(int begin,
+                            int end,
+                            int grain,
+                            const std::function<void(int, int)>& function) {
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    // A few chunks per thread so stealing can even out uneven work
+    int chunks = this->threadCount() * 4;
+    int chunk = (count + chunks - 1) / chunks;
+    if (chunk < grain) {
+        chunk = grain;
+    }
+    if (chunk >= count) {
+        function(begin, end);
+        return;
+    }
+
+    JobCounter counter;
+    for (int b = begin + chunk; b < end; b += chunk) {
+        int e = b + chunk < end ? b + chunk : end;
+        this->run([&function, b, e] { function(b, e); }, &counter);
+    }
+    function(begin, begin + chunk);
+    this->wait(&counter);
+}
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_JOBS
+#define _HOMD_JOBS
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs a worker runs before it checks for sleep again
+#define JOB_SPIN_ROUNDS 64
+
+struct Job;
+
+/**
+ * Counts the jobs of a group that have not finished yet.
+ *
+ * Waiting on a counter returns once it drops to zero, jobs scheduled to
+ * run after a counter start once it does.
+ */
+class JobCounter {
+    friend class JobSystem;
+
+    std::atomic<int> value{0};
+    std::mutex mutex;
+    // Jobs waiting for the counter to reach zero
+    std::vector<Job> continuations;
+
+   public:
+    JobCounter() = default;
+    ~JobCounter();
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    [[nodiscard]] bool done() const;
+};
+
+using Job = struct Job {
+    std::function<void()> function;
+    // Decremented once the job finishes, may be nullptr
+    JobCounter* counter;
+};
+
+/**
+ * Work-stealing job scheduler.
+ *
+ * Every worker owns a deque, it pushes and pops its own jobs at the back
+ * while idle workers steal the oldest jobs from the front of the others.
+ * Threads that are not workers, such as the main thread, submit into a
+ * deque of their own and help running jobs while they wait.
+ */
+class JobSystem {
+    using Queue = struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    // One queue per worker, the last one is shared by outside threads
+    std::vector<Queue> queues;
+    // Jobs sitting in a queue, the workers sleep while it is zero
+    std::atomic<int> pending{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool quit = false;
+
+    void workerLoop(int index);
+    void push(Job job);
+    void finish(JobCounter* counter);
+
+    /**
+     * Takes a job, from the own queue first and the others after.
+     *
+     * @param index the queue of the calling thread
+     * @param job where to put the job
+     *
+     * @return whether a job was found
+     */
+    bool take(int index, Job& job);
+
+    // Queue the calling thread pushes to and pops from
+    int queueIndex() const;
+
+   public:
+    /**
+     * Starts the workers.
+     *
+     * @param threadCount the number of threads running jobs, including the
+     * thread that waits on them, 0 for one per core
+     */
+    JobSystem(int threadCount = 0);
+    ~JobSystem();
+
+    // Number of threads running jobs, including the waiting thread
+    [[nodiscard]] int threadCount() const;
+
+    /**
+     * Schedules a job.
+     *
+     * @param function what to run
+     * @param counter counter to increment now and decrement once the job
+     * finished, may be nullptr
+     * @param after counter the job waits for before it starts, may be
+     * nullptr
+     */
+    void run(std::function<void()> function,
+             JobCounter* counter = nullptr,
+             JobCounter* after = nullptr);
+
+    /**
+     * Runs jobs on the calling thread until the counter reaches zero.
+     *
+     * @param counter the counter to wait on
+     */
+    void wait(JobCounter* counter);
+
+    /**
+     * Splits a range into chunks, runs them as jobs and waits for all.
+     *
+     * @param begin the first index
+     * @param end one past the last index
+     * @param grain the smallest chunk worth a job
+     * @param function called with the begin and end of every chunk
+     */
+    void parallelFor(int begin,
+                     int end,
+                     int grain,
+                     const std::function<void(int, int)>& function);
+};
+
+#endif
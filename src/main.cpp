@@ -16,13 +16,88 @@
  */
 
 #include <game/game.h>
+#include <graphics/graphics.h>
+#include <profile/profiler.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Frames and target size of a headless run unless given
+#define HEADLESS_DEFAULT_FRAMES 600
+#define HEADLESS_DEFAULT_WIDTH 1280
+#define HEADLESS_DEFAULT_HEIGHT 720
 
 #ifdef __WIN32
 int wmain(int argc, char** argv) {
 #else
 int main(int argc, char** argv) {
 #endif
-    auto* game = new Game;
+    // --headless draws --frames N frames of --size WxH offscreen and
+    // writes a JSON report to stdout, or to --output FILE
+    bool headless = false;
+    // --profile FILE writes a Chrome trace of the run when it ends
+    const char* profilePath = nullptr;
+    HeadlessConfig config = {HEADLESS_DEFAULT_FRAMES, HEADLESS_DEFAULT_WIDTH,
+                             HEADLESS_DEFAULT_HEIGHT, nullptr};
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            config.frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &config.width, &config.height) !=
+                2) {
+                fprintf(stderr, "--size takes WIDTHxHEIGHT\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            config.output = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && hasValue) {
+            profilePath = argv[++i];
+        }
+    }
+    if (headless &&
+        (config.frames <= 0 || config.width <= 0 || config.height <= 0)) {
+        fprintf(stderr, "Headless runs need a positive frame count and size\n");
+        return 1;
+    }
+
+    auto* game = new Game(headless ? &config : nullptr);
+
+    // --vsync, --uncapped, --cap=N or --adaptive=N select the frame pacing,
+    // --pipelined runs scene updates on a worker thread, --gpu-draws times
+    // every draw on the GPU besides the passes
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--vsync") == 0) {
+            game->setPacing(FramePacing::VSync);
+        } else if (strcmp(argv[i], "--uncapped") == 0) {
+            game->setPacing(FramePacing::Uncapped);
+        } else if (strncmp(argv[i], "--cap=", 6) == 0) {
+            game->setPacing(FramePacing::Cap, atoi(argv[i] + 6));
+        } else if (strncmp(argv[i], "--adaptive=", 11) == 0) {
+            game->setPacing(FramePacing::Adaptive, atoi(argv[i] + 11));
+        } else if (strcmp(argv[i], "--pipelined") == 0) {
+            if (headless) {
+                fprintf(stderr, "--pipelined is ignored in headless runs\n");
+            }
+            game->setPipelined(true);
+        } else if (strcmp(argv[i], "--gpu-draws") == 0) {
+            game->pRenderer->gpuTimer.timeDraws = true;
+        }
+    }
+
     game->loop();
+    delete game;
+
+    if (profilePath != nullptr) {
+#ifdef HOMD_PROFILE
+        if (!PROFILE_WRITE_TRACE(profilePath)) {
+            fprintf(stderr, "Could not write the trace to %s\n", profilePath);
+        }
+#else
+        fprintf(stderr, "Built without HOMD_PROFILE, no trace written\n");
+#endif
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,470 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math/mat4.h>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(HOMD_SIMD_SSE)
+#include <immintrin.h>
+#elif defined(HOMD_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(HOMD_SIMD_SSE)
+#define SHUFFLE_MASK(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define SWIZZLE(v, x, y, z, w) \
+    _mm_shuffle_ps((v), (v), SHUFFLE_MASK(x, y, z, w))
+#define SHUFFLE(a, b, x, y, z, w) \
+    _mm_shuffle_ps((a), (b), SHUFFLE_MASK(x, y, z, w))
+
+// Multiply-add, fused when the target has FMA
+static inline __m128 madd(__m128 a, __m128 b, __m128 c) {
+#if defined(__FMA__)
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// 2x2 matrix product A * B, matrices packed as (m00, m01, m10, m11)
+static inline __m128 mat2Mul(__m128 a, __m128 b) {
+    return _mm_add_ps(
+        _mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)),
+        _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// 2x2 adjugate product adj(A) * B
+static inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+    return _mm_sub_ps(
+        _mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b),
+        _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// 2x2 adjugate product A * adj(B)
+static inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+    return _mm_sub_ps(
+        _mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)),
+        _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+#endif
+
+Mat4 Mat4::identity() {
+    Mat4 r{};
+    r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0F;
+    return r;
+}
+
+Mat4 Mat4::operator*(const Mat4& other) const {
+    Mat4 r;
+    mul(r.m, this->m, other.m);
+    return r;
+}
+
+Vec4 Mat4::operator*(const Vec4& v) const {
+    Vec4 r;
+    mulVec4(&r.x, this->m, &v.x);
+    return r;
+}
+
+Mat4 Mat4::transposed() const {
+    Mat4 r;
+    transpose(r.m, this->m);
+    return r;
+}
+
+Mat4 Mat4::inverse() const {
+    Mat4 r = identity();
+    invert(r.m, this->m);
+    return r;
+}
+
+Mat4 Mat4::inverseRigid() const {
+    Mat4 r;
+    invertRigid(r.m, this->m);
+    return r;
+}
+
+void Mat4::mul(float* out, const float* a, const float* b) {
+#if defined(HOMD_SIMD_AVX)
+    // Two result columns per iteration, each 128-bit lane holds one column
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    __m256 aa0 = _mm256_insertf128_ps(_mm256_castps128_ps256(a0), a0, 1);
+    __m256 aa1 = _mm256_insertf128_ps(_mm256_castps128_ps256(a1), a1, 1);
+    __m256 aa2 = _mm256_insertf128_ps(_mm256_castps128_ps256(a2), a2, 1);
+    __m256 aa3 = _mm256_insertf128_ps(_mm256_castps128_ps256(a3), a3, 1);
+    __m256 b01 = _mm256_loadu_ps(b);
+    __m256 b23 = _mm256_loadu_ps(b + 8);
+
+    __m256 r01 = _mm256_mul_ps(aa0, _mm256_permute_ps(b01, 0x00));
+    __m256 r23 = _mm256_mul_ps(aa0, _mm256_permute_ps(b23, 0x00));
+#if defined(__FMA__)
+    r01 = _mm256_fmadd_ps(aa1, _mm256_permute_ps(b01, 0x55), r01);
+    r23 = _mm256_fmadd_ps(aa1, _mm256_permute_ps(b23, 0x55), r23);
+    r01 = _mm256_fmadd_ps(aa2, _mm256_permute_ps(b01, 0xAA), r01);
+    r23 = _mm256_fmadd_ps(aa2, _mm256_permute_ps(b23, 0xAA), r23);
+    r01 = _mm256_fmadd_ps(aa3, _mm256_permute_ps(b01, 0xFF), r01);
+    r23 = _mm256_fmadd_ps(aa3, _mm256_permute_ps(b23, 0xFF), r23);
+#else
+    r01 = _mm256_add_ps(r01, _mm256_mul_ps(aa1, _mm256_permute_ps(b01, 0x55)));
+    r23 = _mm256_add_ps(r23, _mm256_mul_ps(aa1, _mm256_permute_ps(b23, 0x55)));
+    r01 = _mm256_add_ps(r01, _mm256_mul_ps(aa2, _mm256_permute_ps(b01, 0xAA)));
+    r23 = _mm256_add_ps(r23, _mm256_mul_ps(aa2, _mm256_permute_ps(b23, 0xAA)));
+    r01 = _mm256_add_ps(r01, _mm256_mul_ps(aa3, _mm256_permute_ps(b01, 0xFF)));
+    r23 = _mm256_add_ps(r23, _mm256_mul_ps(aa3, _mm256_permute_ps(b23, 0xFF)));
+#endif
+    _mm256_storeu_ps(out, r01);
+    _mm256_storeu_ps(out + 8, r23);
+#elif defined(HOMD_SIMD_SSE)
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    __m128 r[4];
+
+    for (int i = 0; i < 4; ++i) {
+        __m128 col = _mm_loadu_ps(b + (ptrdiff_t)(i * 4));
+        r[i] = _mm_mul_ps(a0, SWIZZLE(col, 0, 0, 0, 0));
+        r[i] = madd(a1, SWIZZLE(col, 1, 1, 1, 1), r[i]);
+        r[i] = madd(a2, SWIZZLE(col, 2, 2, 2, 2), r[i]);
+        r[i] = madd(a3, SWIZZLE(col, 3, 3, 3, 3), r[i]);
+    }
+    for (int i = 0; i < 4; ++i) {
+        _mm_storeu_ps(out + (ptrdiff_t)(i * 4), r[i]);
+    }
+#elif defined(HOMD_SIMD_NEON)
+    float32x4_t a0 = vld1q_f32(a);
+    float32x4_t a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8);
+    float32x4_t a3 = vld1q_f32(a + 12);
+    float32x4_t r[4];
+
+    for (int i = 0; i < 4; ++i) {
+        const float* col = b + (ptrdiff_t)(i * 4);
+        r[i] = vmulq_n_f32(a0, col[0]);
+        r[i] = vmlaq_n_f32(r[i], a1, col[1]);
+        r[i] = vmlaq_n_f32(r[i], a2, col[2]);
+        r[i] = vmlaq_n_f32(r[i], a3, col[3]);
+    }
+    for (int i = 0; i < 4; ++i) {
+        vst1q_f32(out + (ptrdiff_t)(i * 4), r[i]);
+    }
+#else
+    float tmp[16];
+
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            tmp[col * 4 + row] = a[row] * b[col * 4] +
+                                 a[4 + row] * b[col * 4 + 1] +
+                                 a[8 + row] * b[col * 4 + 2] +
+                                 a[12 + row] * b[col * 4 + 3];
+        }
+    }
+    memcpy(out, tmp, sizeof tmp);
+#endif
+}
+
+void Mat4::mulVec4(float* out, const float* m, const float* v) {
+#if defined(HOMD_SIMD_SSE)
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v[0]));
+    r = madd(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1]), r);
+    r = madd(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2]), r);
+    r = madd(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3]), r);
+    _mm_storeu_ps(out, r);
+#elif defined(HOMD_SIMD_NEON)
+    float32x4_t r = vmulq_n_f32(vld1q_f32(m), v[0]);
+    r = vmlaq_n_f32(r, vld1q_f32(m + 4), v[1]);
+    r = vmlaq_n_f32(r, vld1q_f32(m + 8), v[2]);
+    r = vmlaq_n_f32(r, vld1q_f32(m + 12), v[3]);
+    vst1q_f32(out, r);
+#else
+    float tmp[4];
+    for (int row = 0; row < 4; ++row) {
+        tmp[row] = m[row] * v[0] + m[4 + row] * v[1] + m[8 + row] * v[2] +
+                   m[12 + row] * v[3];
+    }
+    memcpy(out, tmp, sizeof tmp);
+#endif
+}
+
+void Mat4::transpose(float* out, const float* m) {
+#if defined(HOMD_SIMD_SSE)
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, c3);
+#elif defined(HOMD_SIMD_NEON)
+    // The de-interleaving load hands out the rows directly
+    float32x4x4_t rows = vld4q_f32(m);
+    vst1q_f32(out, rows.val[0]);
+    vst1q_f32(out + 4, rows.val[1]);
+    vst1q_f32(out + 8, rows.val[2]);
+    vst1q_f32(out + 12, rows.val[3]);
+#else
+    float t[16] = {m[0], m[4], m[8],  m[12], m[1], m[5], m[9],  m[13],
+                   m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]};
+    memcpy(out, t, sizeof t);
+#endif
+}
+
+bool Mat4::invert(float* out, const float* m) {
+#if defined(HOMD_SIMD_SSE)
+    // Block-wise inversion over the four 2x2 sub matrices
+    //     | A B |
+    // M = | C D |
+    // Works the same on columns as it does on rows since
+    // inverse(transpose(M)) == transpose(inverse(M)).
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+
+    __m128 A = _mm_movelh_ps(c0, c1);
+    __m128 B = _mm_movehl_ps(c1, c0);
+    __m128 C = _mm_movelh_ps(c2, c3);
+    __m128 D = _mm_movehl_ps(c3, c2);
+
+    // Determinants of the sub matrices as (|A|, |B|, |C|, |D|)
+    __m128 detSub = _mm_sub_ps(
+        _mm_mul_ps(SHUFFLE(c0, c2, 0, 2, 0, 2), SHUFFLE(c1, c3, 1, 3, 1, 3)),
+        _mm_mul_ps(SHUFFLE(c0, c2, 1, 3, 1, 3), SHUFFLE(c1, c3, 0, 2, 0, 2)));
+    __m128 detA = SWIZZLE(detSub, 0, 0, 0, 0);
+    __m128 detB = SWIZZLE(detSub, 1, 1, 1, 1);
+    __m128 detC = SWIZZLE(detSub, 2, 2, 2, 2);
+    __m128 detD = SWIZZLE(detSub, 3, 3, 3, 3);
+
+    __m128 dc = mat2AdjMul(D, C);
+    __m128 ab = mat2AdjMul(A, B);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, dc));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, ab));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, ab));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, dc));
+
+    // |M| = |A|*|D| + |B|*|C| - tr(adj(A)B * adj(D)C)
+    __m128 tr = _mm_mul_ps(ab, SWIZZLE(dc, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, SWIZZLE(tr, 1, 0, 3, 2));
+    tr = _mm_add_ps(tr, SWIZZLE(tr, 2, 3, 0, 1));
+    __m128 detM = _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+    if (_mm_cvtss_f32(detM) == 0.0F) {
+        return false;
+    }
+
+    __m128 rDetM = _mm_div_ps(_mm_setr_ps(1.0F, -1.0F, -1.0F, 1.0F), detM);
+    x = _mm_mul_ps(x, rDetM);
+    y = _mm_mul_ps(y, rDetM);
+    z = _mm_mul_ps(z, rDetM);
+    w = _mm_mul_ps(w, rDetM);
+
+    _mm_storeu_ps(out, SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_storeu_ps(out + 4, SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_storeu_ps(out + 8, SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_storeu_ps(out + 12, SHUFFLE(z, w, 2, 0, 2, 0));
+    return true;
+#else
+    float inv[16];
+
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] -
+             m[9] * m[6] * m[15] + m[9] * m[7] * m[14] +
+             m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] +
+             m[8] * m[6] * m[15] - m[8] * m[7] * m[14] -
+             m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] -
+             m[8] * m[5] * m[15] + m[8] * m[7] * m[13] +
+             m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] +
+              m[8] * m[5] * m[14] - m[8] * m[6] * m[13] -
+              m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] +
+             m[9] * m[2] * m[15] - m[9] * m[3] * m[14] -
+             m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] -
+             m[8] * m[2] * m[15] + m[8] * m[3] * m[14] +
+             m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] +
+             m[8] * m[1] * m[15] - m[8] * m[3] * m[13] -
+             m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] -
+              m[8] * m[1] * m[14] + m[8] * m[2] * m[13] +
+              m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] -
+             m[5] * m[2] * m[15] + m[5] * m[3] * m[14] +
+             m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] +
+             m[4] * m[2] * m[15] - m[4] * m[3] * m[14] -
+             m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] -
+              m[4] * m[1] * m[15] + m[4] * m[3] * m[13] +
+              m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] +
+              m[4] * m[1] * m[14] - m[4] * m[2] * m[13] -
+              m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] +
+             m[5] * m[2] * m[11] - m[5] * m[3] * m[10] -
+             m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] -
+             m[4] * m[2] * m[11] + m[4] * m[3] * m[10] +
+             m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] +
+              m[4] * m[1] * m[11] - m[4] * m[3] * m[9] -
+              m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] -
+              m[4] * m[1] * m[10] + m[4] * m[2] * m[9] +
+              m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0.0F) {
+        return false;
+    }
+
+    det = 1.0F / det;
+    for (int i = 0; i < 16; ++i) {
+        out[i] = inv[i] * det;
+    }
+    return true;
+#endif
+}
+
+void Mat4::invertRigid(float* out, const float* m) {
+    // inv(T * R) = inv(R) * inv(T) = transpose(R) * T(-t)
+#if defined(HOMD_SIMD_SSE)
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 t = _mm_loadu_ps(m + 12);
+    __m128 c3 = _mm_setr_ps(0.0F, 0.0F, 0.0F, 1.0F);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    __m128 r = _mm_mul_ps(c0, SWIZZLE(t, 0, 0, 0, 0));
+    r = madd(c1, SWIZZLE(t, 1, 1, 1, 1), r);
+    r = madd(c2, SWIZZLE(t, 2, 2, 2, 2), r);
+    r = _mm_sub_ps(c3, r);
+
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, r);
+#else
+    float tmp[16] = {m[0], m[4], m[8], 0, m[1], m[5], m[9], 0,
+                     m[2], m[6], m[10], 0, 0, 0, 0, 1};
+    for (int row = 0; row < 3; ++row) {
+        tmp[12 + row] = -(tmp[row] * m[12] + tmp[4 + row] * m[13] +
+                          tmp[8 + row] * m[14]);
+    }
+    memcpy(out, tmp, sizeof tmp);
+#endif
+}
+
+void Mat4::translate(float* m, float x, float y, float z) {
+#if defined(HOMD_SIMD_SSE)
+    __m128 r = _mm_loadu_ps(m + 12);
+    r = madd(_mm_loadu_ps(m), _mm_set1_ps(x), r);
+    r = madd(_mm_loadu_ps(m + 4), _mm_set1_ps(y), r);
+    r = madd(_mm_loadu_ps(m + 8), _mm_set1_ps(z), r);
+    _mm_storeu_ps(m + 12, r);
+#elif defined(HOMD_SIMD_NEON)
+    float32x4_t r = vld1q_f32(m + 12);
+    r = vmlaq_n_f32(r, vld1q_f32(m), x);
+    r = vmlaq_n_f32(r, vld1q_f32(m + 4), y);
+    r = vmlaq_n_f32(r, vld1q_f32(m + 8), z);
+    vst1q_f32(m + 12, r);
+#else
+    for (int row = 0; row < 4; ++row) {
+        m[12 + row] += m[row] * x + m[4 + row] * y + m[8 + row] * z;
+    }
+#endif
+}
+
+void Mat4::rotate(float* m, float angle, float x, float y, float z) {
+    float s = std::sin(angle);
+    float c = std::cos(angle);
+    float ic = 1.0F - c;
+
+    // Upper 3x3 of the rotation matrix, column-major
+    float r[12] = {x * x * ic + c,     y * x * ic + z * s, x * z * ic - y * s,
+                   0,                  x * y * ic - z * s, y * y * ic + c,
+                   y * z * ic + x * s, 0,                  x * z * ic + y * s,
+                   y * z * ic - x * s, z * z * ic + c,     0};
+
+#if defined(HOMD_SIMD_SSE)
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+
+    for (int i = 0; i < 3; ++i) {
+        const float* col = r + (ptrdiff_t)(i * 4);
+        __m128 v = _mm_mul_ps(c0, _mm_set1_ps(col[0]));
+        v = madd(c1, _mm_set1_ps(col[1]), v);
+        v = madd(c2, _mm_set1_ps(col[2]), v);
+        _mm_storeu_ps(m + (ptrdiff_t)(i * 4), v);
+    }
+#elif defined(HOMD_SIMD_NEON)
+    float32x4_t c0 = vld1q_f32(m);
+    float32x4_t c1 = vld1q_f32(m + 4);
+    float32x4_t c2 = vld1q_f32(m + 8);
+
+    for (int i = 0; i < 3; ++i) {
+        const float* col = r + (ptrdiff_t)(i * 4);
+        float32x4_t v = vmulq_n_f32(c0, col[0]);
+        v = vmlaq_n_f32(v, c1, col[1]);
+        v = vmlaq_n_f32(v, c2, col[2]);
+        vst1q_f32(m + (ptrdiff_t)(i * 4), v);
+    }
+#else
+    float tmp[12];
+    for (int i = 0; i < 3; ++i) {
+        for (int row = 0; row < 4; ++row) {
+            tmp[i * 4 + row] = m[row] * r[i * 4] + m[4 + row] * r[i * 4 + 1] +
+                               m[8 + row] * r[i * 4 + 2];
+        }
+    }
+    memcpy(m, tmp, sizeof tmp);
+#endif
+}
+
+void Mat4::perspective(float* m,
+                       float yFOV,
+                       float aspect,
+                       float zNear,
+                       float zFar) {
+    double radians = (double)yFOV / 2.0 * M_PI / 180.0;
+    double sine = std::sin(radians);
+    double deltaZ = (double)zFar - (double)zNear;
+    if (deltaZ == 0 || sine == 0 || aspect == 0) {
+        return;
+    }
+    auto cotangent = (float)(std::cos(radians) / sine);
+
+    float tmp[16] = {};
+    tmp[0] = cotangent / aspect;
+    tmp[5] = cotangent;
+    tmp[10] = -(zFar + zNear) / (float)deltaZ;
+    tmp[11] = -1;
+    tmp[14] = -2 * zNear * zFar / (float)deltaZ;
+    memcpy(m, tmp, sizeof(tmp));
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_MATH_MAT4
+#define _HOMD_MATH_MAT4
+
+// Pick the widest instruction set the compiler was told about. Define
+// HOMD_NO_SIMD to force the scalar fallback.
+#if !defined(HOMD_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64)
+#define HOMD_SIMD_SSE 1
+#if defined(__AVX__)
+#define HOMD_SIMD_AVX 1
+#endif
+#elif defined(__ARM_NEON)
+#define HOMD_SIMD_NEON 1
+#endif
+#endif
+
+// A 4 component vector, aligned so it can be loaded as a single register
+struct alignas(16) Vec4 {
+    float x;
+    float y;
+    float z;
+    float w;
+};
+
+/**
+ * A column-major 4x4 matrix, laid out the way glUniformMatrix4fv expects.
+ *
+ * The static kernels work on plain float[16] arrays so they can be used on
+ * unaligned data as well, the output may alias any of the inputs.
+ */
+struct alignas(32) Mat4 {
+    float m[16];
+
+    static Mat4 identity();
+
+    Mat4 operator*(const Mat4&) const;
+    Vec4 operator*(const Vec4&) const;
+    [[nodiscard]] Mat4 transposed() const;
+    [[nodiscard]] Mat4 inverse() const;
+    [[nodiscard]] Mat4 inverseRigid() const;
+
+    /**
+     * Multiplies two 4x4 matrices, out = a * b
+     *
+     * @param out the matrix to store the result in
+     * @param a first matrix
+     * @param b second matrix
+     */
+    static void mul(float* out, const float* a, const float* b);
+
+    /**
+     * Multiplies a 4x4 matrix with a vector, out = m * v
+     *
+     * @param out the vector to store the result in
+     * @param m the matrix
+     * @param v the vector
+     */
+    static void mulVec4(float* out, const float* m, const float* v);
+
+    /**
+     * Transposes a 4x4 matrix.
+     *
+     * @param out the matrix to store the result in
+     * @param m the matrix to transpose
+     */
+    static void transpose(float* out, const float* m);
+
+    /**
+     * Inverts a general 4x4 matrix.
+     *
+     * @param out the matrix to store the result in
+     * @param m the matrix to invert
+     *
+     * @return false if the matrix is singular, out is left untouched then
+     */
+    static bool invert(float* out, const float* m);
+
+    /**
+     * Inverts a matrix made out of only a rotation and a translation, which
+     * is a lot cheaper than the general case.
+     *
+     * @param out the matrix to store the result in
+     * @param m the matrix to invert
+     */
+    static void invertRigid(float* out, const float* m);
+
+    /**
+     * Post-multiplies a matrix with a translation, m = m * T(x, y, z)
+     *
+     * Only the translation column changes so no full product is needed.
+     *
+     * @param[in,out] m the matrix to translate
+     * @param x the x component of the translation
+     * @param y the y component of the translation
+     * @param z the z component of the translation
+     */
+    static void translate(float* m, float x, float y, float z);
+
+    /**
+     * Post-multiplies a matrix with a rotation, m = m * R(angle, x, y, z)
+     *
+     * The translation column is left as is, only the upper 3x3 changes.
+     *
+     * @param[in,out] m the matrix to rotate
+     * @param angle the angle to rotate in radians
+     * @param x the x component of the rotation axis
+     * @param y the y component of the rotation axis
+     * @param z the z component of the rotation axis
+     */
+    static void rotate(float* m, float angle, float x, float y, float z);
+
+    /**
+     * Builds a perspective projection. m is left alone if the parameters
+     * do not make one.
+     *
+     * @param[out] m the projection matrix
+     * @param yFOV the field of view in the y direction in degrees
+     * @param aspect the view aspect ratio
+     * @param zNear the near clipping plane
+     * @param zFar the far clipping plane
+     */
+    static void perspective(float* m,
+                            float yFOV,
+                            float aspect,
+                            float zNear,
+                            float zFar);
+};
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <memory/arena.h>
+#include <cstdint>
+#include <cstdlib>
+
+Arena::Arena(size_t defaultBlockSize) {
+    this->blockSize = defaultBlockSize;
+}
+
+Arena::~Arena() {
+    this->release();
+}
+
+void* Arena::alloc(size_t size, size_t alignment) {
+    // Blocks are laid out as the header followed by the data
+    auto place = [&](Block* block) -> void* {
+        auto base = (uintptr_t)(block + 1);
+        uintptr_t start = (base + block->used + alignment - 1) &
+                          ~(uintptr_t)(alignment - 1);
+        if (start + size > base + block->size) {
+            return nullptr;
+        }
+        block->used = start + size - base;
+        return (void*)start;
+    };
+
+    void* memory = this->head != nullptr ? place(this->head) : nullptr;
+    if (memory == nullptr) {
+        // Oversized requests get a block of their own
+        size_t dataSize = size + alignment > this->blockSize
+                              ? size + alignment
+                              : this->blockSize;
+        auto* block = (Block*)malloc(sizeof(Block) + dataSize);
+        if (block == nullptr) {
+            throw "Arena out of memory";
+        }
+        block->next = this->head;
+        block->size = dataSize;
+        block->used = 0;
+        this->head = block;
+        this->stats.reserved += sizeof(Block) + dataSize;
+        memory = place(block);
+    }
+
+    this->stats.bytes += size;
+    this->stats.count++;
+    if (this->stats.bytes > this->stats.peak) {
+        this->stats.peak = this->stats.bytes;
+    }
+    return memory;
+}
+
+void Arena::release() {
+    while (this->head != nullptr) {
+        Block* next = this->head->next;
+        free(this->head);
+        this->head = next;
+    }
+    this->stats.bytes = 0;
+    this->stats.count = 0;
+    this->stats.reserved = 0;
+}
+
+const AllocStats& Arena::getStats() const {
+    return this->stats;
+}
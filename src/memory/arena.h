@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_MEMORY_ARENA
+#define _HOMD_MEMORY_ARENA
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Size of the blocks an arena grabs from the system at a time
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Memory use of an allocator
+using AllocStats = struct AllocStats {
+    // Bytes handed out and not released yet
+    size_t bytes;
+    // Highest bytes ever reached
+    size_t peak;
+    // Number of allocations not released yet
+    size_t count;
+    // Bytes taken from the system, including unused block space
+    size_t reserved;
+};
+
+/**
+ * Linear allocator.
+ *
+ * Allocations bump a pointer through large blocks and are never freed one
+ * by one, everything goes away at once when the arena is released or
+ * destroyed. Destructors are not run, so only trivially destructible data
+ * should live here directly. Not thread safe.
+ */
+class Arena {
+    using Block = struct Block {
+        Block* next;
+        size_t size;
+        size_t used;
+    };
+
+    Block* head = nullptr;
+    size_t blockSize;
+    AllocStats stats = {0, 0, 0, 0};
+
+   public:
+    Arena(size_t defaultBlockSize = ARENA_BLOCK_SIZE);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * Allocates uninitialized memory.
+     *
+     * @param size the number of bytes
+     * @param alignment what the address has to be a multiple of, a power
+     * of two
+     *
+     * @return the memory, valid until the arena is released
+     */
+    void* alloc(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * Allocates a zeroed array.
+     *
+     * @param count the number of elements
+     */
+    template <typename T>
+    T* allocArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena memory is released without destructors");
+        void* memory = this->alloc(count * sizeof(T), alignof(T));
+        memset(memory, 0, count * sizeof(T));
+        return (T*)memory;
+    }
+
+    // Frees every block, all memory handed out becomes invalid
+    void release();
+
+    [[nodiscard]] const AllocStats& getStats() const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_MEMORY_POOL
+#define _HOMD_MEMORY_POOL
+
+#include <memory/arena.h>
+#include <new>
+#include <utility>
+
+/**
+ * Pool of objects of a single type carved out of an arena.
+ *
+ * Destroyed objects go to a free list and their slots are reused by the
+ * next create. Objects still alive when the arena is released are not
+ * destroyed. Not thread safe.
+ */
+template <typename T>
+class Pool {
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    Arena* arena;
+    Slot* freeList = nullptr;
+    AllocStats stats = {0, 0, 0, 0};
+
+   public:
+    Pool(Arena* backing) { this->arena = backing; }
+
+    /**
+     * Constructs an object.
+     *
+     * @param args the arguments of the constructor
+     */
+    template <typename... Args>
+    T* create(Args&&... args) {
+        Slot* slot = this->freeList;
+        if (slot != nullptr) {
+            this->freeList = slot->next;
+        } else {
+            slot = (Slot*)this->arena->alloc(sizeof(Slot), alignof(Slot));
+            this->stats.reserved += sizeof(Slot);
+        }
+
+        this->stats.bytes += sizeof(T);
+        this->stats.count++;
+        if (this->stats.bytes > this->stats.peak) {
+            this->stats.peak = this->stats.bytes;
+        }
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Destroys an object and keeps its slot for the next create.
+     *
+     * @param object an object created by this pool
+     */
+    void destroy(T* object) {
+        object->~T();
+        auto* slot = (Slot*)object;
+        slot->next = this->freeList;
+        this->freeList = slot;
+        this->stats.bytes -= sizeof(T);
+        this->stats.count--;
+    }
+
+    [[nodiscard]] const AllocStats& getStats() const { return this->stats; }
+};
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <profile/profiler.h>
+
+#ifdef HOMD_PROFILE
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Every ring ever made, they stay around after their thread exits so the
+// trace still has its zones
+static std::mutex ringsMutex;
+static std::vector<std::unique_ptr<ProfileRing>> rings;
+
+static thread_local ProfileRing* threadRing = nullptr;
+// Track of the GPU zones, written by the render thread
+static ProfileRing* gpuRing = nullptr;
+
+static const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
+
+// Makes a ring and adds it to the trace
+static ProfileRing* newRing(const char* name) {
+    auto ring = std::make_unique<ProfileRing>();
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->name = name;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    ring->id = (int)rings.size() + 1;
+    rings.push_back(std::move(ring));
+    return rings.back().get();
+}
+
+// Ring of the calling thread, made on first use
+static ProfileRing* getRing() {
+    if (threadRing == nullptr) {
+        threadRing = newRing(nullptr);
+    }
+    return threadRing;
+}
+
+/**
+ * Adds a finished zone to a ring, only the owner of the ring may call it.
+ *
+ * @param ring the ring
+ * @param name the name of the zone
+ * @param start when the zone began
+ * @param end when the zone ended
+ */
+static void push(ProfileRing* ring,
+                 const char* name,
+                 uint64_t start,
+                 uint64_t end) {
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ProfileEvent& event = ring->events[head % PROFILE_RING_SIZE];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t Profiler::now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - epoch)
+        .count();
+}
+
+void Profiler::record(const char* name, uint64_t start) {
+    uint64_t end = now();
+    push(getRing(), name, start, end);
+}
+
+void Profiler::recordGpu(const char* name, uint64_t start, uint64_t end) {
+    if (gpuRing == nullptr) {
+        gpuRing = newRing("GPU");
+    }
+    push(gpuRing, name, start, end);
+}
+
+void Profiler::setThreadName(const char* name) {
+    getRing()->name = name;
+}
+
+bool Profiler::writeChromeTrace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    bool first = true;
+    std::vector<ProfileEvent> events;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (const auto& ring : rings) {
+        fprintf(file,
+                "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                "\"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                first ? "" : ",", ring->id,
+                ring->name != nullptr ? ring->name : "Thread");
+        first = false;
+
+        // Copy what is complete, then drop what got overwritten while
+        // copying
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE
+                                                  : 0;
+        events.clear();
+        for (uint64_t i = begin; i < head; ++i) {
+            events.push_back(ring->events[i % PROFILE_RING_SIZE]);
+        }
+        uint64_t after = ring->head.load(std::memory_order_acquire);
+        uint64_t valid = after > PROFILE_RING_SIZE ? after - PROFILE_RING_SIZE
+                                                   : 0;
+        size_t skip = valid > begin ? (size_t)(valid - begin) : 0;
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            const ProfileEvent& event = events[i];
+            fprintf(file,
+                    ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+                    "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                    event.name, ring->id, (double)event.start / 1000.0,
+                    (double)(event.end - event.start) / 1000.0);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+#endif
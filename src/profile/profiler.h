@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_PROFILE_PROFILER
+#define _HOMD_PROFILE_PROFILER
+
+// Zones a thread keeps before the oldest are overwritten
+#define PROFILE_RING_SIZE 65536
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef HOMD_PROFILE
+
+#include <atomic>
+#include <cstdint>
+
+// A finished zone, times in nanoseconds since the profiler started
+using ProfileEvent = struct ProfileEvent {
+    // Must outlive the profiler, string literals in practice
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+/**
+ * Zones recorded by one thread. Only the owner writes, the exporter reads
+ * whatever the head says is complete and drops the entries the owner may
+ * have overwritten meanwhile, so neither side takes a lock.
+ */
+using ProfileRing = struct ProfileRing {
+    ProfileEvent events[PROFILE_RING_SIZE];
+    // Number of events ever written
+    std::atomic<uint64_t> head;
+    // Shown as the thread name in the trace
+    const char* name;
+    // Id of the thread in the trace
+    int id;
+};
+
+class Profiler {
+   public:
+    // Nanoseconds since the profiler started
+    static uint64_t now();
+
+    /**
+     * Records a finished zone on the calling thread.
+     *
+     * @param name the name of the zone
+     * @param start when the zone began, from now()
+     */
+    static void record(const char* name, uint64_t start);
+
+    /**
+     * Records a zone of GPU work on the GPU track of the trace. Only the
+     * render thread may call it.
+     *
+     * @param name the name of the zone
+     * @param start when the zone began, in the time of now()
+     * @param end when the zone ended, in the time of now()
+     */
+    static void recordGpu(const char* name, uint64_t start, uint64_t end);
+
+    /**
+     * Names the calling thread in the trace.
+     *
+     * @param name the name, must outlive the profiler
+     */
+    static void setThreadName(const char* name);
+
+    /**
+     * Writes the zones every thread still holds as Chrome trace event
+     * JSON, which about:tracing and Perfetto open.
+     *
+     * @param path the file to write
+     *
+     * @return false if the file could not be written
+     */
+    static bool writeChromeTrace(const char* path);
+};
+
+// Measures the scope it is declared in
+class ProfileZone {
+    const char* name;
+    uint64_t start;
+
+   public:
+    explicit ProfileZone(const char* zoneName) {
+        this->name = zoneName;
+        this->start = Profiler::now();
+    }
+    ~ProfileZone() { Profiler::record(this->name, this->start); }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+// Times the rest of the enclosing scope as a zone called name
+#define PROFILE_ZONE(name) \
+    ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+// Names the calling thread in the trace
+#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+// Nanoseconds on the clock of the zones
+#define PROFILE_NOW() Profiler::now()
+// Adds a span of GPU work measured elsewhere
+#define PROFILE_GPU_ZONE(name, start, end) \
+    Profiler::recordGpu(name, start, end)
+// Writes the trace, evaluates to false if it could not be written
+#define PROFILE_WRITE_TRACE(path) Profiler::writeChromeTrace(path)
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_NOW() ((uint64_t)0)
+#define PROFILE_GPU_ZONE(name, start, end) ((void)0)
+#define PROFILE_WRITE_TRACE(path) false
+
+#endif
+
+#endif
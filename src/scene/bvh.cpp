@@ -0,0 +1,496 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <scene/bvh.h>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+static Aabb unite(const Aabb& a, const Aabb& b) {
+    Aabb r;
+    for (int axis = 0; axis < 3; ++axis) {
+        r.min[axis] = a.min[axis] < b.min[axis] ? a.min[axis] : b.min[axis];
+        r.max[axis] = a.max[axis] > b.max[axis] ? a.max[axis] : b.max[axis];
+    }
+    return r;
+}
+
+// Surface area, what the cost of visiting a node grows with
+static float area(const Aabb& box) {
+    float dx = box.max[0] - box.min[0];
+    float dy = box.max[1] - box.min[1];
+    float dz = box.max[2] - box.min[2];
+    return 2.0F * (dx * dy + dy * dz + dz * dx);
+}
+
+static bool contains(const Aabb& outer, const Aabb& inner) {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (inner.min[axis] < outer.min[axis] ||
+            inner.max[axis] > outer.max[axis]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Aabb grow(const Aabb& box, float margin) {
+    Aabb r;
+    for (int axis = 0; axis < 3; ++axis) {
+        r.min[axis] = box.min[axis] - margin;
+        r.max[axis] = box.max[axis] + margin;
+    }
+    return r;
+}
+
+// -1 when the box is outside the frustum, 1 when inside, 0 when it
+// straddles a plane
+static int classify(const Frustum& frustum, const Aabb& box) {
+    int result = 1;
+    for (const Vec4& p : frustum.planes) {
+        // The corners furthest along and against the plane normal
+        float ahead = p.w;
+        float behind = p.w;
+        ahead += p.x * (p.x > 0 ? box.max[0] : box.min[0]);
+        ahead += p.y * (p.y > 0 ? box.max[1] : box.min[1]);
+        ahead += p.z * (p.z > 0 ? box.max[2] : box.min[2]);
+        if (ahead < 0) {
+            return -1;
+        }
+        behind += p.x * (p.x > 0 ? box.min[0] : box.max[0]);
+        behind += p.y * (p.y > 0 ? box.min[1] : box.max[1]);
+        behind += p.z * (p.z > 0 ? box.min[2] : box.max[2]);
+        if (behind < 0) {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/**
+ * Slab test of a ray against a box.
+ *
+ * @param[out] entry where the ray enters the box, 0 if it starts inside
+ *
+ * @return whether the ray hits the box before maxDistance
+ */
+static bool rayHitsBox(const float origin[3],
+                       const float direction[3],
+                       const Aabb& box,
+                       float maxDistance,
+                       float* entry) {
+    float t0 = 0.0F;
+    float t1 = maxDistance;
+    for (int axis = 0; axis < 3; ++axis) {
+        // Infinities are not an option with fast math
+        if (direction[axis] == 0.0F) {
+            if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis]) {
+                return false;
+            }
+            continue;
+        }
+        float inverse = 1.0F / direction[axis];
+        float tNear = (box.min[axis] - origin[axis]) * inverse;
+        float tFar = (box.max[axis] - origin[axis]) * inverse;
+        if (tNear > tFar) {
+            float swap = tNear;
+            tNear = tFar;
+            tFar = swap;
+        }
+        t0 = tNear > t0 ? tNear : t0;
+        t1 = tFar < t1 ? tFar : t1;
+        if (t0 > t1) {
+            return false;
+        }
+    }
+    *entry = t0;
+    return true;
+}
+
+static float distanceSq(const float point[3], const Aabb& box) {
+    float d = 0.0F;
+    for (int axis = 0; axis < 3; ++axis) {
+        float below = box.min[axis] - point[axis];
+        float above = point[axis] - box.max[axis];
+        float out = below > 0 ? below : above > 0 ? above : 0.0F;
+        d += out * out;
+    }
+    return d;
+}
+
+Bvh::Bvh(float leafMargin) {
+    this->margin = leafMargin;
+}
+
+int Bvh::allocNode() {
+    int node;
+    if (this->freeList != BVH_NULL) {
+        node = this->freeList;
+        this->freeList = this->nodes[node].parent;
+    } else {
+        node = (int)this->nodes.size();
+        this->nodes.emplace_back();
+    }
+    Node& n = this->nodes[node];
+    n.parent = BVH_NULL;
+    n.child[0] = BVH_NULL;
+    n.child[1] = BVH_NULL;
+    n.height = 0;
+    n.object = BVH_NULL;
+    return node;
+}
+
+void Bvh::freeNode(int node) {
+    this->nodes[node].parent = this->freeList;
+    this->nodes[node].height = -1;
+    this->freeList = node;
+}
+
+int Bvh::insert(const Aabb& box, int object) {
+    int leaf = allocNode();
+    Node& n = this->nodes[leaf];
+    n.objectBox = box;
+    n.box = grow(box, this->margin);
+    n.object = object;
+    insertLeaf(leaf);
+    this->leafCount++;
+    return leaf;
+}
+
+void Bvh::remove(int proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    this->leafCount--;
+}
+
+bool Bvh::update(int proxy, const Aabb& box) {
+    Node& leaf = this->nodes[proxy];
+    leaf.objectBox = box;
+    if (contains(leaf.box, box)) {
+        return false;
+    }
+    Aabb grown = grow(box, this->margin);
+
+    // Refitting keeps the tree as it is, fine as long as the parent does
+    // not end up much larger than it was
+    int parent = leaf.parent;
+    if (parent != BVH_NULL) {
+        const Node& p = this->nodes[parent];
+        int sibling = p.child[0] == proxy ? p.child[1] : p.child[0];
+        float refitArea = area(unite(grown, this->nodes[sibling].box));
+        if (refitArea <= 2.0F * area(p.box)) {
+            leaf.box = grown;
+            refitUp(parent);
+            return true;
+        }
+    }
+
+    removeLeaf(proxy);
+    this->nodes[proxy].box = grown;
+    insertLeaf(proxy);
+    return true;
+}
+
+int Bvh::size() const {
+    return this->leafCount;
+}
+
+int Bvh::height() const {
+    return this->root == BVH_NULL ? 0 : this->nodes[this->root].height;
+}
+
+void Bvh::insertLeaf(int leaf) {
+    if (this->root == BVH_NULL) {
+        this->root = leaf;
+        this->nodes[leaf].parent = BVH_NULL;
+        return;
+    }
+
+    // Walk down to the sibling that adds the least surface area, counting
+    // the growth of every ancestor on the way
+    Aabb box = this->nodes[leaf].box;
+    int index = this->root;
+    while (this->nodes[index].height > 0) {
+        const Node& n = this->nodes[index];
+        float nodeArea = area(n.box);
+        float combinedArea = area(unite(n.box, box));
+        // Pairing with this node creates a parent of the combined size
+        float cost = 2.0F * combinedArea;
+        // Going further down still grows this node
+        float inherited = 2.0F * (combinedArea - nodeArea);
+
+        float childCost[2];
+        for (int c = 0; c < 2; ++c) {
+            const Node& child = this->nodes[n.child[c]];
+            float enlarged = area(unite(box, child.box));
+            childCost[c] = child.height == 0
+                               ? enlarged + inherited
+                               : enlarged - area(child.box) + inherited;
+        }
+        if (cost < childCost[0] && cost < childCost[1]) {
+            break;
+        }
+        index = childCost[0] < childCost[1] ? n.child[0] : n.child[1];
+    }
+
+    int sibling = index;
+    int oldParent = this->nodes[sibling].parent;
+    int newParent = allocNode();
+    Node& p = this->nodes[newParent];
+    p.parent = oldParent;
+    p.box = unite(box, this->nodes[sibling].box);
+    p.height = this->nodes[sibling].height + 1;
+    p.child[0] = sibling;
+    p.child[1] = leaf;
+    this->nodes[sibling].parent = newParent;
+    this->nodes[leaf].parent = newParent;
+
+    if (oldParent == BVH_NULL) {
+        this->root = newParent;
+    } else if (this->nodes[oldParent].child[0] == sibling) {
+        this->nodes[oldParent].child[0] = newParent;
+    } else {
+        this->nodes[oldParent].child[1] = newParent;
+    }
+
+    refitUp(newParent);
+}
+
+void Bvh::removeLeaf(int leaf) {
+    if (leaf == this->root) {
+        this->root = BVH_NULL;
+        return;
+    }
+
+    int parent = this->nodes[leaf].parent;
+    int grandParent = this->nodes[parent].parent;
+    const Node& p = this->nodes[parent];
+    int sibling = p.child[0] == leaf ? p.child[1] : p.child[0];
+
+    // The sibling takes the place of the parent
+    this->nodes[sibling].parent = grandParent;
+    freeNode(parent);
+    if (grandParent == BVH_NULL) {
+        this->root = sibling;
+        return;
+    }
+    Node& g = this->nodes[grandParent];
+    g.child[g.child[0] == parent ? 0 : 1] = sibling;
+    refitUp(grandParent);
+}
+
+void Bvh::refitUp(int node) {
+    while (node != BVH_NULL) {
+        node = balance(node);
+        Node& n = this->nodes[node];
+        const Node& a = this->nodes[n.child[0]];
+        const Node& b = this->nodes[n.child[1]];
+        n.height = 1 + (a.height > b.height ? a.height : b.height);
+        n.box = unite(a.box, b.box);
+        node = n.parent;
+    }
+}
+
+int Bvh::balance(int iA) {
+    Node& a = this->nodes[iA];
+    if (a.height < 2) {
+        return iA;
+    }
+
+    int iB = a.child[0];
+    int iC = a.child[1];
+    Node& b = this->nodes[iB];
+    Node& c = this->nodes[iC];
+    int lean = c.height - b.height;
+    if (lean >= -1 && lean <= 1) {
+        return iA;
+    }
+
+    // The taller child moves up and takes A as one of its children, A
+    // keeps the shorter grandchild
+    int iUp = lean > 1 ? iC : iB;
+    int stay = lean > 1 ? 0 : 1;
+    Node& up = this->nodes[iUp];
+    const Node& kept = this->nodes[a.child[stay]];
+    int iF = up.child[0];
+    int iG = up.child[1];
+    Node& f = this->nodes[iF];
+    Node& g = this->nodes[iG];
+
+    up.parent = a.parent;
+    a.parent = iUp;
+    if (up.parent == BVH_NULL) {
+        this->root = iUp;
+    } else {
+        Node& parent = this->nodes[up.parent];
+        parent.child[parent.child[0] == iA ? 0 : 1] = iUp;
+    }
+
+    // The taller grandchild stays with the node moving up
+    int iTall = f.height > g.height ? iF : iG;
+    int iShort = f.height > g.height ? iG : iF;
+    Node& tall = this->nodes[iTall];
+    Node& shortest = this->nodes[iShort];
+    up.child[0] = iA;
+    up.child[1] = iTall;
+    a.child[1 - stay] = iShort;
+    shortest.parent = iA;
+
+    a.box = unite(kept.box, shortest.box);
+    a.height = 1 + (kept.height > shortest.height ? kept.height
+                                                  : shortest.height);
+    up.box = unite(a.box, tall.box);
+    up.height = 1 + (a.height > tall.height ? a.height : tall.height);
+    return iUp;
+}
+
+void Bvh::collectLeaves(int node, std::vector<int>& objects) const {
+    const Node& n = this->nodes[node];
+    if (n.height == 0) {
+        objects.push_back(n.object);
+        return;
+    }
+    collectLeaves(n.child[0], objects);
+    collectLeaves(n.child[1], objects);
+}
+
+void Bvh::queryFrustum(const Frustum& frustum,
+                       std::vector<int>& objects) const {
+    if (this->root == BVH_NULL) {
+        return;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = this->root;
+    while (top > 0) {
+        const Node& n = this->nodes[stack[--top]];
+        if (n.height == 0) {
+            if (classify(frustum, n.objectBox) >= 0) {
+                objects.push_back(n.object);
+            }
+            continue;
+        }
+
+        int side = classify(frustum, n.box);
+        if (side < 0) {
+            continue;
+        }
+        if (side > 0) {
+            collectLeaves(n.child[0], objects);
+            collectLeaves(n.child[1], objects);
+            continue;
+        }
+        assert(top + 2 <= BVH_STACK_SIZE);
+        stack[top++] = n.child[0];
+        stack[top++] = n.child[1];
+    }
+}
+
+int Bvh::raycast(const float origin[3],
+                 const float direction[3],
+                 float maxDistance,
+                 float* distance) const {
+    int hit = BVH_NULL;
+    float best = maxDistance;
+    if (this->root == BVH_NULL) {
+        return hit;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = this->root;
+    while (top > 0) {
+        const Node& n = this->nodes[stack[--top]];
+        float entry;
+        if (n.height == 0) {
+            if (rayHitsBox(origin, direction, n.objectBox, best, &entry)) {
+                best = entry;
+                hit = n.object;
+            }
+            continue;
+        }
+        if (!rayHitsBox(origin, direction, n.box, best, &entry)) {
+            continue;
+        }
+
+        // The nearer child goes on top, its hits prune the other one
+        float entries[2];
+        bool hits[2];
+        for (int c = 0; c < 2; ++c) {
+            hits[c] = rayHitsBox(origin, direction,
+                                 this->nodes[n.child[c]].box, best,
+                                 &entries[c]);
+        }
+        int nearer = hits[0] && (!hits[1] || entries[0] <= entries[1]) ? 0 : 1;
+        assert(top + 2 <= BVH_STACK_SIZE);
+        if (hits[1 - nearer]) {
+            stack[top++] = n.child[1 - nearer];
+        }
+        if (hits[nearer]) {
+            stack[top++] = n.child[nearer];
+        }
+    }
+
+    if (hit != BVH_NULL) {
+        *distance = best;
+    }
+    return hit;
+}
+
+int Bvh::nearest(const float point[3], float* distance) const {
+    int found = BVH_NULL;
+    float best = FLT_MAX;
+    if (this->root == BVH_NULL) {
+        return found;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = this->root;
+    while (top > 0) {
+        const Node& n = this->nodes[stack[--top]];
+        if (n.height == 0) {
+            float d = distanceSq(point, n.objectBox);
+            if (d < best) {
+                best = d;
+                found = n.object;
+            }
+            continue;
+        }
+        // The best may have improved since the node was pushed
+        if (distanceSq(point, n.box) >= best) {
+            continue;
+        }
+
+        // Closer child on top, subtrees further than the best are skipped
+        float d[2];
+        for (int c = 0; c < 2; ++c) {
+            d[c] = distanceSq(point, this->nodes[n.child[c]].box);
+        }
+        int nearer = d[0] <= d[1] ? 0 : 1;
+        assert(top + 2 <= BVH_STACK_SIZE);
+        if (d[1 - nearer] < best) {
+            stack[top++] = n.child[1 - nearer];
+        }
+        if (d[nearer] < best) {
+            stack[top++] = n.child[nearer];
+        }
+    }
+
+    *distance = std::sqrt(best);
+    return found;
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_SCENE_BVH
+#define _HOMD_SCENE_BVH
+
+#include <graphics/culling.h>
+#include <vector>
+
+// Handle of no node
+#define BVH_NULL (-1)
+// Default growth of leaf boxes, objects moving less than this do not
+// touch the tree
+#define BVH_DEFAULT_MARGIN 0.1F
+// Entries of the traversal stack of the queries. Balancing keeps the
+// height below 1.44 * log2(n), so this covers any tree that fits in memory.
+#define BVH_STACK_SIZE 64
+
+/**
+ * Dynamic bounding volume hierarchy over the boxes of scene objects.
+ *
+ * Leaves keep their object box grown by a margin, so small movements
+ * cost nothing. Larger ones refit the boxes up the tree in place, unless
+ * that would bloat the parent, then the leaf is moved to a better spot.
+ * Rotations keep the tree balanced, queries visit O(log n) nodes for
+ * objects spread over the scene. Queries do not change the tree and can
+ * run on several threads at once.
+ */
+class Bvh {
+    using Node = struct Node {
+        // Box of the subtree, the grown object box for leaves
+        Aabb box;
+        // Exact box of the object, leaves only
+        Aabb objectBox;
+        // Next free node for free nodes
+        int parent;
+        int child[2];
+        // 0 for leaves, -1 for free nodes
+        int height;
+        int object;
+    };
+
+    std::vector<Node> nodes;
+    int root = BVH_NULL;
+    int freeList = BVH_NULL;
+    int leafCount = 0;
+    float margin;
+
+    int allocNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    // Refits the boxes and heights from a node to the root
+    void refitUp(int node);
+    // Rotates the subtree at a node if it leans, returns its new root
+    int balance(int node);
+    void collectLeaves(int node, std::vector<int>& objects) const;
+
+   public:
+    Bvh(float leafMargin = BVH_DEFAULT_MARGIN);
+
+    /**
+     * Adds an object.
+     *
+     * @param box the box of the object
+     * @param object what queries hand back for the object
+     *
+     * @return the handle of the object in the tree
+     */
+    int insert(const Aabb& box, int object);
+
+    // Removes an object by the handle insert returned
+    void remove(int proxy);
+
+    /**
+     * Moves an object.
+     *
+     * @param proxy the handle of the object
+     * @param box the new box of the object
+     *
+     * @return false if the box still fit in the grown one and nothing
+     * changed
+     */
+    bool update(int proxy, const Aabb& box);
+
+    [[nodiscard]] int size() const;
+    // Height of the tree, 0 for a single object
+    [[nodiscard]] int height() const;
+
+    /**
+     * Finds the objects whose boxes touch a frustum. Subtrees fully
+     * inside are taken without testing them any further.
+     *
+     * @param frustum the frustum
+     * @param[out] objects the objects found, appended
+     */
+    void queryFrustum(const Frustum& frustum, std::vector<int>& objects) const;
+
+    /**
+     * Finds the first object box a ray hits.
+     *
+     * @param origin the start of the ray
+     * @param direction the direction of the ray, not necessarily unit
+     * length
+     * @param maxDistance how far along the ray to look, in multiples of
+     * direction
+     * @param[out] distance where the hit is, in multiples of direction
+     *
+     * @return the object hit, BVH_NULL if none
+     */
+    int raycast(const float origin[3],
+                const float direction[3],
+                float maxDistance,
+                float* distance) const;
+
+    /**
+     * Finds the object box closest to a point.
+     *
+     * @param point the point
+     * @param[out] distance the distance to the box, 0 when inside
+     *
+     * @return the closest object, BVH_NULL for an empty tree
+     */
+    int nearest(const float point[3], float* distance) const;
+};
+
+#endif
@@ -0,0 +1,362 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <graphics/meshopt.h>
+#include <graphics/vertex.h>
+#include <jobs/jobs.h>
+#include <memory/arena.h>
+#include <scene/gears/gearmesh.h>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+
+static const VertexAttrib gearVertexAttribs[2] = {
+    {0, 3, GL_FLOAT, GL_FALSE, 0},
+    {1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3},
+};
+
+static const VertexAttrib packedGearVertexAttribs[2] = {
+    {0, 3, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedGearVertex, position)},
+    {1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedGearVertex, normal)},
+};
+
+const VertexLayout GEAR_VERTEX_LAYOUT = {gearVertexAttribs, 2,
+                                         sizeof(GearVertex)};
+const VertexLayout PACKED_GEAR_VERTEX_LAYOUT = {packedGearVertexAttribs, 2,
+                                                sizeof(PackedGearVertex)};
+
+void packGearVertices(const GearVertex* vertices,
+                      int count,
+                      PackedGearVertex* packed) {
+    for (int i = 0; i < count; ++i) {
+        const GLfloat* v = vertices[i];
+        packed[i].position[0] = packHalf(v[0]);
+        packed[i].position[1] = packHalf(v[1]);
+        packed[i].position[2] = packHalf(v[2]);
+        packed[i].position[3] = packHalf(1.0F);
+
+        // The side normals are not unit length, the shader normalizes
+        // them anyway
+        float length = std::sqrt(v[3] * v[3] + v[4] * v[4] + v[5] * v[5]);
+        float scale = length > 0.0F ? 1.0F / length : 0.0F;
+        packed[i].normal =
+            packNormal(v[3] * scale, v[4] * scale, v[5] * scale);
+    }
+}
+
+using Point = struct {
+    GLfloat x;
+    GLfloat y;
+};
+
+// Writes the vertices and strips of a single tooth, all of its state is
+// local so teeth can be built on any thread
+class ToothWriter {
+    GearVertex* vertex;
+    const GearVertex* base;
+    VertexStrip* strip;
+    GLfloat normal[3] = {0, 0, 0};
+    GLfloat halfWidth;
+
+   public:
+    Point points[7];
+
+    ToothWriter(GearVertex* vertices,
+                int firstVertex,
+                VertexStrip* strips,
+                int firstStrip,
+                GLfloat width) {
+        this->base = vertices;
+        this->vertex = vertices + firstVertex;
+        this->strip = strips + firstStrip;
+        this->halfWidth = width * 0.5F;
+    }
+
+    void setNormal(GLfloat x, GLfloat y, GLfloat z) {
+        this->normal[0] = x;
+        this->normal[1] = y;
+        this->normal[2] = z;
+    }
+
+    void vert(int point, int sign) {
+        GLfloat* v = *this->vertex;
+        v[0] = this->points[point].x;
+        v[1] = this->points[point].y;
+        v[2] = (GLfloat)sign * this->halfWidth;
+        v[3] = this->normal[0];
+        v[4] = this->normal[1];
+        v[5] = this->normal[2];
+        this->vertex++;
+    }
+
+    void quadWithNormal(int p1, int p2) {
+        setNormal(this->points[p1].y - this->points[p2].y,
+                  -(this->points[p1].x - this->points[p2].x), 0);
+        vert(p1, -1);
+        vert(p1, 1);
+        vert(p2, -1);
+        vert(p2, 1);
+    }
+
+    void startStrip() {
+        this->strip->first = (GLint)(this->vertex - this->base);
+    }
+
+    void endStrip() {
+        this->strip->count =
+            (GLsizei)(this->vertex - this->base) - this->strip->first;
+        this->strip++;
+    }
+};
+
+/**
+ * Builds one tooth of a gear.
+ *
+ * @param mesh the mesh to write into
+ * @param params the shape of the gear
+ * @param sinTable sines of every quarter tooth angle
+ * @param cosTable cosines of every quarter tooth angle
+ * @param tooth the index of the tooth
+ */
+static void buildTooth(GearMesh* mesh,
+                       const GearParams& params,
+                       const double* sinTable,
+                       const double* cosTable,
+                       int tooth) {
+    GLfloat rad0 = params.innerRad;
+    GLfloat rad1 = params.outerRad - params.toothDepth / 2.0F;
+    GLfloat rad2 = params.outerRad + params.toothDepth / 2.0F;
+
+    // A tooth spans five quarter angles, the last one is shared with the
+    // next tooth
+    const double* s = sinTable + (ptrdiff_t)tooth * 4;
+    const double* c = cosTable + (ptrdiff_t)tooth * 4;
+    auto point = [&](GLfloat radius, int quarter) {
+        return Point{(float)(radius * c[quarter]),
+                     (float)(radius * s[quarter])};
+    };
+
+    ToothWriter w(mesh->vertices, tooth * VERTICES_PER_TOOTH, mesh->strips,
+                  tooth * STRIPS_PER_TOOTH, params.width);
+
+    // Create 7 points (x,y coords) that make up a tooth
+    w.points[0] = point(rad2, 1);
+    w.points[1] = point(rad2, 2);
+    w.points[2] = point(rad1, 0);
+    w.points[3] = point(rad1, 3);
+    w.points[4] = point(rad0, 0);
+    w.points[5] = point(rad1, 4);
+    w.points[6] = point(rad0, 4);
+
+    // Front face
+    w.startStrip();
+    w.setNormal(0, 0, 1.0);
+    for (int i = 0; i < 7; ++i) {
+        w.vert(i, +1);
+    }
+    w.endStrip();
+
+    // Inner face
+    w.startStrip();
+    w.quadWithNormal(4, 6);
+    w.endStrip();
+
+    // Back face
+    w.startStrip();
+    w.setNormal(0, 0, -1.0);
+    for (int i = 6; i >= 0; --i) {
+        w.vert(i, -1);
+    }
+    w.endStrip();
+
+    // Outer face
+    const int outer[4][2] = {{0, 2}, {1, 0}, {3, 1}, {5, 3}};
+    for (const auto& quad : outer) {
+        w.startStrip();
+        w.quadWithNormal(quad[0], quad[1]);
+        w.endStrip();
+    }
+}
+
+bool GearParams::operator==(const GearParams& other) const {
+    return this->innerRad == other.innerRad &&
+           this->outerRad == other.outerRad && this->width == other.width &&
+           this->teeth == other.teeth && this->toothDepth == other.toothDepth;
+}
+
+size_t GearParamsHash::operator()(const GearParams& params) const {
+    const GLfloat fields[5] = {params.innerRad, params.outerRad, params.width,
+                               (GLfloat)params.teeth, params.toothDepth};
+    size_t hash = 0;
+    for (GLfloat field : fields) {
+        uint32_t bits;
+        memcpy(&bits, &field, sizeof bits);
+        hash = hash * 31 + bits;
+    }
+    return hash;
+}
+
+bool gearLodParams(const GearParams& params, int level, GearParams* lod) {
+    *lod = params;
+    for (int i = 0; i < level; ++i) {
+        int teeth = lod->teeth / 2;
+        if (teeth < GEAR_LOD_MIN_TEETH) {
+            return false;
+        }
+        lod->teeth = teeth;
+    }
+    return true;
+}
+
+GearMeshCache::GearMeshCache(Arena* backing) {
+    this->arena = backing;
+}
+
+void GearMeshCache::buildTeeth(Entry* entry) {
+    int teeth = entry->params.teeth;
+    while (true) {
+        int begin = entry->nextTooth.fetch_add(MIN_TEETH_PER_JOB,
+                                               std::memory_order_relaxed);
+        if (begin >= teeth) {
+            return;
+        }
+        int end = begin + MIN_TEETH_PER_JOB < teeth ? begin + MIN_TEETH_PER_JOB
+                                                    : teeth;
+        for (int tooth = begin; tooth < end; ++tooth) {
+            buildTooth(&entry->mesh, entry->params, entry->sinTable,
+                       entry->cosTable, tooth);
+        }
+        entry->doneTeeth.fetch_add(end - begin, std::memory_order_release);
+    }
+}
+
+GearMeshCache::Entry* GearMeshCache::acquire(const GearParams& params,
+                                             JobSystem* jobs) {
+    Entry* entry;
+    bool owner = false;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto found = this->entries.find(params);
+        if (found != this->entries.end()) {
+            entry = found->second;
+        } else {
+            // Reserve the entry and its storage, the teeth are built
+            // without the lock so other shapes are not held up
+            int teeth = params.teeth;
+            entry = (Entry*)this->arena->alloc(sizeof(Entry), alignof(Entry));
+            entry->params = params;
+            entry->mesh.nVertices = VERTICES_PER_TOOTH * teeth;
+            entry->mesh.nStrips = STRIPS_PER_TOOTH * teeth;
+            entry->mesh.vertices =
+                this->arena->allocArray<GearVertex>(entry->mesh.nVertices);
+            entry->mesh.strips =
+                this->arena->allocArray<VertexStrip>(entry->mesh.nStrips);
+            new (&entry->nextTooth) std::atomic<int>(0);
+            new (&entry->doneTeeth) std::atomic<int>(0);
+            entry->optimized = nullptr;
+            new (&entry->optimizeOnce) std::once_flag;
+            entry->buffers = {};
+
+            // Every quarter tooth angle once, instead of five sincos per
+            // tooth
+            int angles = teeth * 4 + 1;
+            entry->sinTable = this->arena->allocArray<double>(angles);
+            entry->cosTable = this->arena->allocArray<double>(angles);
+            for (int i = 0; i < angles; ++i) {
+                double angle = (double)i * 2.0 * M_PI / teeth / 4.0;
+                entry->sinTable[i] = std::sin(angle);
+                entry->cosTable[i] = std::cos(angle);
+            }
+
+            this->entries.emplace(params, entry);
+            owner = true;
+        }
+    }
+
+    // Everyone asking for the mesh claims chunks of teeth until none are
+    // left. A claimed chunk is built without waiting on anything, so the
+    // wait below always ends, even when a job run by the owner's wait
+    // asks for the same mesh.
+    if (owner && jobs != nullptr) {
+        JobCounter helpers;
+        int chunks = (params.teeth + MIN_TEETH_PER_JOB - 1) / MIN_TEETH_PER_JOB;
+        int helperCount = jobs->threadCount() < chunks ? jobs->threadCount()
+                                                       : chunks;
+        for (int i = 1; i < helperCount; ++i) {
+            jobs->run([this, entry] { buildTeeth(entry); }, &helpers);
+        }
+        buildTeeth(entry);
+        jobs->wait(&helpers);
+    } else {
+        buildTeeth(entry);
+    }
+
+    while (entry->doneTeeth.load(std::memory_order_acquire) < params.teeth) {
+        std::this_thread::yield();
+    }
+    return entry;
+}
+
+const GearMesh* GearMeshCache::get(const GearParams& params,
+                                   JobSystem* jobs) {
+    return &acquire(params, jobs)->mesh;
+}
+
+void GearMeshCache::optimize(Entry* entry) {
+    const GearMesh& mesh = entry->mesh;
+    OptimizedMesh welded;
+    optimizeStripMesh(mesh.vertices, mesh.nVertices, sizeof(GearVertex),
+                      mesh.strips, mesh.nStrips, welded);
+
+    OptimizedGearMesh* optimized;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        optimized = (OptimizedGearMesh*)this->arena->alloc(
+            sizeof(OptimizedGearMesh), alignof(OptimizedGearMesh));
+        optimized->nVertices = welded.nVertices;
+        optimized->nIndices = (int)welded.indices.size();
+        optimized->vertices =
+            this->arena->allocArray<GearVertex>(optimized->nVertices);
+        optimized->packed =
+            this->arena->allocArray<PackedGearVertex>(optimized->nVertices);
+        optimized->indices =
+            this->arena->allocArray<GLuint>(optimized->nIndices);
+    }
+
+    memcpy(optimized->vertices, welded.vertices.data(),
+           optimized->nVertices * sizeof(GearVertex));
+    packGearVertices(optimized->vertices, optimized->nVertices,
+                     optimized->packed);
+    memcpy(optimized->indices, welded.indices.data(),
+           optimized->nIndices * sizeof(GLuint));
+    optimized->acmrBefore = welded.acmrBefore;
+    optimized->acmrAfter = welded.acmrAfter;
+    entry->optimized = optimized;
+}
+
+const OptimizedGearMesh* GearMeshCache::getOptimized(const GearParams& params,
+                                                     JobSystem* jobs) {
+    Entry* entry = acquire(params, jobs);
+    std::call_once(entry->optimizeOnce, [this, entry] { optimize(entry); });
+    return entry->optimized;
+}
+
+GearMeshBuffers* GearMeshCache::getBuffers(const GearParams& params) {
+    return &acquire(params, nullptr)->buffers;
+}
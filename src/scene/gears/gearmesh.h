@@ -0,0 +1,227 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOMD_SCENE_GEARS_GEARMESH
+#define _HOMD_SCENE_GEARS_GEARMESH
+
+#include <GLES3/gl3.h>
+#include <GL/glew.h>
+#include <graphics/vertex.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#define STRIPS_PER_TOOTH 7
+#define VERTICES_PER_TOOTH 34
+#define GEAR_VERTEX_STRIDE 6
+
+// Teeth a thread claims at a time while generating a mesh
+#define MIN_TEETH_PER_JOB 16
+
+// Detail levels of a gear, each with half the teeth of the one before
+#define GEAR_LOD_LEVELS 3
+// Coarser levels do not go below this many teeth
+#define GEAR_LOD_MIN_TEETH 5
+
+class Arena;
+class JobSystem;
+
+// Each vertex consists of GEAR_VERTEX_STRIDE GLfloat attributes
+using GearVertex = GLfloat[GEAR_VERTEX_STRIDE];
+
+// A GearVertex in half the size, half float position padded to four
+// components and a 2_10_10_10 normal
+using PackedGearVertex = struct PackedGearVertex {
+    GLushort position[4];
+    GLuint normal;
+};
+
+// Layouts of the two vertex formats, position at location 0 and normal
+// at location 1
+extern const VertexLayout GEAR_VERTEX_LAYOUT;
+extern const VertexLayout PACKED_GEAR_VERTEX_LAYOUT;
+
+/**
+ * Packs gear vertices into the compact format.
+ *
+ * @param vertices the vertices to pack
+ * @param count the number of vertices
+ * @param[out] packed where to write the packed vertices
+ */
+void packGearVertices(const GearVertex* vertices,
+                      int count,
+                      PackedGearVertex* packed);
+
+// The shape of a gear, two gears with equal parameters share a mesh
+using GearParams = struct GearParams {
+    // Radius of the hole at the center
+    GLfloat innerRad;
+    // Radius at the center of the teeth
+    GLfloat outerRad;
+    // Width of the gear
+    GLfloat width;
+    // The number of teeth
+    int teeth;
+    // The depth of the teeth
+    GLfloat toothDepth;
+
+    bool operator==(const GearParams& other) const;
+};
+
+struct GearParamsHash {
+    size_t operator()(const GearParams& params) const;
+};
+
+/**
+ * Shape of a detail level of a gear. Every level halves the teeth, and
+ * with them the segments of the inner ring, the outline keeps its radii.
+ *
+ * @param params the shape of the gear
+ * @param level the detail level, 0 for the full gear
+ * @param[out] lod the shape of the level
+ *
+ * @return false if the level would not have fewer teeth than the one
+ * before
+ */
+bool gearLodParams(const GearParams& params, int level, GearParams* lod);
+
+// Vertices and triangle strips of a gear, owned by the mesh cache
+using GearMesh = struct GearMesh {
+    GearVertex* vertices;
+    int nVertices;
+    VertexStrip* strips;
+    int nStrips;
+};
+
+// A gear mesh welded and ordered for the post-transform cache, drawn as a
+// single indexed triangle list. Owned by the mesh cache.
+using OptimizedGearMesh = struct OptimizedGearMesh {
+    GearVertex* vertices;
+    // The same vertices in the compact format
+    PackedGearVertex* packed;
+    int nVertices;
+    GLuint* indices;
+    int nIndices;
+    // Average cache miss ratio of the strips and of the triangle list
+    float acmrBefore;
+    float acmrAfter;
+};
+
+// GPU copy of a gear mesh, all zero until the first gear of the shape
+// uploads it
+using GearMeshBuffers = struct GearMeshBuffers {
+    // Vertex buffer object holding the vertices in the GPU
+    GLuint vertexBufObj;
+    // Index buffer object of the optimized triangle list, 0 when the mesh
+    // is drawn strip by strip
+    GLuint indexBufObj;
+    // Number of indices in the index buffer object
+    GLsizei nIndices;
+    // Vertex array object describing the vertex layout
+    GLuint vertexArrayObj;
+};
+
+/**
+ * Generates gear meshes and keeps them by their parameters, so gears of
+ * the same shape share one mesh, its optimized form and its GPU buffers.
+ *
+ * Every tooth writes to its own range of the mesh, so teeth are generated
+ * in parallel when a job system is given. Meshes live in the arena the
+ * cache is created with. Safe to call from any thread, except for the
+ * buffers which belong to the thread owning the context.
+ */
+class GearMeshCache {
+    using Entry = struct Entry {
+        GearParams params;
+        GearMesh mesh;
+        // Built by the first getOptimized of the shape
+        OptimizedGearMesh* optimized;
+        std::once_flag optimizeOnce;
+        GearMeshBuffers buffers;
+        // Sines and cosines of every quarter tooth angle
+        double* sinTable;
+        double* cosTable;
+        // First tooth nobody has claimed yet
+        std::atomic<int> nextTooth;
+        // Number of teeth built so far
+        std::atomic<int> doneTeeth;
+    };
+
+    Arena* arena;
+    // Guards the map and the arena
+    std::mutex mutex;
+    std::unordered_map<GearParams, Entry*, GearParamsHash> entries;
+
+    // Builds unclaimed chunks of teeth until none are left
+    static void buildTeeth(Entry* entry);
+
+    // Finds the entry of a shape, generating its mesh on first use
+    Entry* acquire(const GearParams& params, JobSystem* jobs);
+
+    // Welds, reorders and packs the mesh of an entry
+    void optimize(Entry* entry);
+
+   public:
+    GearMeshCache(Arena* backing);
+
+    /**
+     * Returns the mesh of a gear, generating it on first use.
+     *
+     * @param params the shape of the gear
+     * @param jobs the job system to generate the teeth with, may be
+     * nullptr
+     *
+     * @return the mesh, valid until the arena is released
+     */
+    const GearMesh* get(const GearParams& params, JobSystem* jobs = nullptr);
+
+    /**
+     * Returns the mesh of a gear as an optimized triangle list, building
+     * it on first use.
+     *
+     * @param params the shape of the gear
+     * @param jobs the job system to generate the teeth with, may be
+     * nullptr
+     *
+     * @return the mesh, valid until the arena is released
+     */
+    const OptimizedGearMesh* getOptimized(const GearParams& params,
+                                          JobSystem* jobs = nullptr);
+
+    /**
+     * Returns the GPU buffers shared by every gear of a shape, the caller
+     * uploads them when they are still empty.
+     *
+     * @param params the shape of the gear
+     */
+    GearMeshBuffers* getBuffers(const GearParams& params);
+
+    /**
+     * Calls a function with the buffers of every shape, for deleting them.
+     *
+     * @param fn called with a GearMeshBuffers& per shape
+     */
+    template <typename Fn>
+    void forEachBuffers(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (auto& entry : this->entries) {
+            fn(entry.second->buffers);
+        }
+    }
+};
+
+#endif
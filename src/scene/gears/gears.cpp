@@ -20,11 +20,17 @@
 #include <SDL2/SDL_keycode.h>
 #include <SDL2/SDL_scancode.h>
 #include <game/game.h>
+#include <game/report.h>
 #include <graphics/graphics.h>
+#include <jobs/jobs.h>
+#include <profile/profiler.h>
 #include <scene/gears/gears.h>
 #include <cstddef>
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 static const char* vertexShader = R"(
     attribute vec3 position;
@@ -57,6 +63,48 @@ static const char* vertexShader = R"(
     }
 )";
 
+// Same lighting as vertexShader, with the data coming from the FrameBlock
+// and ObjectBlock uniform blocks instead of separate uniforms. The
+// INSTANCED variant reads the matrices and the color from per-instance
+// attribute streams instead of ObjectBlock.
+static const char* blockVertexShader = R"(
+    #version 140
+    in vec3 position;
+    in vec3 normal;
+
+    layout(std140) uniform FrameBlock {
+        mat4 ViewMatrix;
+        mat4 ProjectionMatrix;
+        vec4 LightSourcePosition;
+    };
+
+    #ifdef INSTANCED
+    in mat4 ModelViewProjectionMatrix;
+    in mat4 NormalMatrix;
+    in vec4 MaterialColor;
+    #else
+    layout(std140) uniform ObjectBlock {
+        mat4 ModelViewProjectionMatrix;
+        mat4 NormalMatrix;
+        vec4 MaterialColor;
+    };
+    #endif
+
+    out vec4 Color;
+
+    void main(void) {
+        vec3 N = normalize(vec3(NormalMatrix * vec4(normal, 1.0)));
+        vec3 L = normalize(LightSourcePosition.xyz);
+
+        float diffuse = max(dot(N, L), 0.0);
+        float ambient = 0.2;
+
+        Color = vec4((ambient + diffuse) * MaterialColor.xyz, MaterialColor.a);
+
+        gl_Position = ModelViewProjectionMatrix * vec4(position, 1.0);
+    }
+)";
+
 static const char* fragmentShader = R"(
     #ifdef GL_ES
     precision mediump float;
@@ -68,78 +116,162 @@ static const char* fragmentShader = R"(
     }
 )";
 
-GearsScene::GearsScene(Game* pGame) {
-    this->pGame = pGame;
+// Fragment shader matching the GLSL 1.40 vertex shaders
+static const char* blockFragmentShader = R"(
+    #version 140
+    in vec4 Color;
+    out vec4 FragColor;
 
-    Graphics::enable(GL_CULL_FACE);
-    Graphics::enable(GL_DEPTH_TEST);
-
-    pGame->pRenderer->compileShader(vertexShader, GL_VERTEX_SHADER);
-    pGame->pRenderer->compileShader(fragmentShader, GL_FRAGMENT_SHADER);
-    pGame->pRenderer->bindAttribLoc(0, "position");
-    pGame->pRenderer->bindAttribLoc(1, "normal");
+    void main(void) {
+        FragColor = Color;
+    }
+)";
 
-    pGame->pRenderer->useProgram();
+// Attributes of every gear shader, names the shader does not use are
+// ignored
+static const ShaderAttrib gearAttribs[5] = {
+    {0, "position"},
+    {1, "normal"},
+    {INSTANCE_MVP_ATTR, "ModelViewProjectionMatrix"},
+    {INSTANCE_NORMAL_ATTR, "NormalMatrix"},
+    {INSTANCE_COLOR_ATTR, "MaterialColor"},
+};
 
-    modelViewProjectionMatrixLoc =
-        pGame->pRenderer->getUniformLoc("ModelViewProjectionMatrix");
-    normalMatrixLoc = pGame->pRenderer->getUniformLoc("NormalMatrix");
-    lightSrcPosLoc = pGame->pRenderer->getUniformLoc("LightSourcePosition");
-    materialColorLoc = pGame->pRenderer->getUniformLoc("MaterialColor");
+static const char* const gearDefines[1] = {"INSTANCED"};
 
-    Graphics::setUniformValue((GLint)lightSrcPosLoc, lightSourcePos);
+// Where the gears sit relative to the view
+static const float gearPositions[3][3] = {
+    {-3.0, -2.0, 0}, {3.1, -2.0, 0}, {-3.1, 4.2, 0}};
 
-    gears[0] = createGear(1.0, 4.0, 1.0, 20, 0.7);
-    gears[1] = createGear(0.5, 2.0, 2.0, 10, 0.7);
-    gears[2] = createGear(1.3, 2.0, 0.5, 10, 0.7);
+/**
+ * Rotation of a gear, they turn in step so the teeth mesh.
+ *
+ * @param gear the index of the gear
+ * @param angle the rotation angle of the scene in degrees
+ *
+ * @return the rotation of the gear in radians
+ */
+static float gearAngle(int gear, GLfloat angle) {
+    static const float factor[3] = {1.0F, -2.0F, -2.0F};
+    static const float offset[3] = {0.0F, -9.0F, -25.0F};
+    return 2.0F * (float)M_PI * (factor[gear] * angle + offset[gear]) /
+           360.0F;
 }
 
-void GearsScene::fillGearVertex(GLfloat x,
-                                GLfloat y,
-                                GLfloat z,
-                                const GLfloat n[3]) {
-    vertex[0][0] = x;
-    vertex[0][1] = y;
-    vertex[0][2] = z;
-    vertex[0][3] = n[0];
-    vertex[0][4] = n[1];
-    vertex[0][5] = n[2];
-    vertex += 1;
+/**
+ * Box around a mesh box turned around z and moved.
+ *
+ * @param box the box of the mesh
+ * @param position where the mesh is moved to
+ * @param rad the rotation around z in radians
+ */
+static Aabb placeBox(const Aabb& box, const float position[3], float rad) {
+    float c = std::cos(rad);
+    float s = std::sin(rad);
+    float center[3];
+    float half[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        center[axis] = (box.min[axis] + box.max[axis]) * 0.5F;
+        half[axis] = (box.max[axis] - box.min[axis]) * 0.5F;
+    }
+    const float placed[3] = {c * center[0] - s * center[1] + position[0],
+                             s * center[0] + c * center[1] + position[1],
+                             center[2] + position[2]};
+    const float extent[3] = {
+        std::fabs(c) * half[0] + std::fabs(s) * half[1],
+        std::fabs(s) * half[0] + std::fabs(c) * half[1], half[2]};
+
+    Aabb r;
+    for (int axis = 0; axis < 3; ++axis) {
+        r.min[axis] = placed[axis] - extent[axis];
+        r.max[axis] = placed[axis] + extent[axis];
+    }
+    return r;
 }
 
-Point GearsScene::GearPoint(GLfloat radius, int diameter) {
-    return Point{(float)((radius)*cosArr[(diameter)]),
-                 (float)((radius)*sinArr[(diameter)])};
-}
+static const ShaderDesc gearShader = {
+    vertexShader, fragmentShader, gearAttribs, 2, nullptr, 0};
+static const ShaderDesc gearBlockShader = {
+    blockVertexShader, blockFragmentShader, gearAttribs, 5, gearDefines, 1};
 
-void GearsScene::setNormal(GLfloat x, GLfloat y, GLfloat z) {
-    normal[0] = x;
-    normal[1] = y;
-    normal[2] = z;
-}
+GearsScene::GearsScene(Game* pGame) {
+    this->pGame = pGame;
 
-void GearsScene::gearVert(int point, int sign, GLfloat gearWidth) {
-    fillGearVertex(points[(point)].x, points[(point)].y,
-                   (GLfloat)(sign)*gearWidth * 0.5F, normal);
-}
+    Graphics::enable(GL_CULL_FACE);
+    Graphics::enable(GL_DEPTH_TEST);
 
-void GearsScene::startStrip(Gear* gear, int& currentStrip) {
-    gear->strips[currentStrip].first = (GLint)(vertex - gear->vertices);
-}
+    // Pick the cheapest way of feeding the gears the context can do
+    if (!Graphics::supportsUniformBuffers()) {
+        path = GearsPath::Uniforms;
+    } else if (Graphics::supportsInstancing()) {
+        path = GearsPath::Instanced;
+    } else {
+        path = GearsPath::UniformBlocks;
+    }
+    instanced = path == GearsPath::Instanced;
+    packedVertices = Graphics::supportsPackedVertices();
+
+    shaders.init(path == GearsPath::Uniforms ? gearShader : gearBlockShader,
+                 &pGame->pRenderer->programCache);
+    program = shaders.get(instanced ? GEAR_VARIANT_INSTANCED : 0);
+    Graphics::useProgram(program);
+
+    if (path == GearsPath::Uniforms) {
+        modelViewProjectionMatrixLoc =
+            program->getUniformLoc("ModelViewProjectionMatrix");
+        normalMatrixLoc = program->getUniformLoc("NormalMatrix");
+        lightSrcPosLoc = program->getUniformLoc("LightSourcePosition");
+        materialColorLoc = program->getUniformLoc("MaterialColor");
+
+        Graphics::setUniformValue((GLint)lightSrcPosLoc, lightSourcePos);
+    } else {
+        program->bindUniformBlock("FrameBlock", FRAME_BLOCK_BINDING);
+        program->bindUniformBlock("ObjectBlock", OBJECT_BLOCK_BINDING);
+    }
+
+    gears[0] = createGear(1.0, 4.0, 1.0, 20, 0.7);
+    gears[1] = createGear(0.5, 2.0, 2.0, 10, 0.7);
+    gears[2] = createGear(1.3, 2.0, 0.5, 10, 0.7);
+
+    // All gears hang off the view transform
+    transforms.parents.resize(1);
+    for (int i = 0; i < 3; ++i) {
+        const float* p = gearPositions[i];
+        transforms.add(p[0], p[1], p[2], 0);
+        transforms.radius[i] = boundsRadiusAroundOrigin(gears[i]->bounds);
+        gearNodes[i] =
+            addNode(placeBox(gears[i]->bounds.box, p, gearAngle(i, 0)), i);
+    }
 
-void GearsScene::endStrip(Gear* gear, int& currentStrip) {
-    int _tmp = (GLint)(vertex - gear->vertices);
-    gear->strips[currentStrip].count = _tmp - gear->strips[currentStrip].first;
-    currentStrip++;
+    if (instanced) {
+        const GLfloat colors[3][4] = {
+            {0.8, 0.1, 0.0, 1.0}, {0.0, 0.8, 0.2, 1.0}, {0.2, 0.2, 1.0, 1.0}};
+        Graphics::storeVertexBufObj(colorBufObj, sizeof(colors),
+                                    (int*)colors);
+    }
+
+#ifdef DEBUG
+    const AllocStats& stats = arena.getStats();
+    fprintf(stderr, "Gears scene: %zu bytes in %zu allocations, %zu reserved\n",
+            stats.bytes, stats.count, stats.reserved);
+#endif
 }
 
-void GearsScene::quadWithNormal(int p1, int p2, GLfloat gearWidth) {
-    setNormal((points[(p1)].y - points[(p2)].y),
-              -(points[(p1)].x - points[(p2)].x), 0);
-    gearVert((p1), -1, gearWidth);
-    gearVert((p1), 1, gearWidth);
-    gearVert((p2), -1, gearWidth);
-    gearVert((p2), 1, gearWidth);
+GearsScene::~GearsScene() {
+    for (Gear* gear : gears) {
+        gearPool.destroy(gear);
+    }
+    meshes.forEachBuffers([](GearMeshBuffers& buffers) {
+        glDeleteVertexArrays(1, &buffers.vertexArrayObj);
+        glDeleteBuffers(1, &buffers.vertexBufObj);
+        glDeleteBuffers(1, &buffers.indexBufObj);
+    });
+    glDeleteBuffers(1, &colorBufObj);
+    glDeleteBuffers(1, &overflowBufObj);
+    shaders.release();
+    // The vertex array cache may still name the deleted objects
+    Graphics::invalidateState();
+    // Meshes go away with the arena
 }
 
 Gear* GearsScene::createGear(GLfloat innerRad,
@@ -147,141 +279,186 @@ Gear* GearsScene::createGear(GLfloat innerRad,
                              GLfloat gearWidth,
                              GLfloat teeth,
                              GLfloat toothDepth) {
-    GLfloat rad0;
-    GLfloat rad1;
-    GLfloat rad2;
-    GLfloat diameter;
-    Gear* gear;
-    int currentStrip = 0;
-
-    gear = (Gear*)malloc(sizeof *gear);
-
-    // Calculate the radii used in the gear
-    rad0 = innerRad;
-    rad1 = outerRad - toothDepth / 2.0F;
-    rad2 = outerRad + toothDepth / 2.0F;
-
-    diameter = 2.0F * (float)M_PI / teeth / 4.0F;
-
-    // Allocate triangle strip information
-    gear->nStrips = STRIPS_PER_TOOTH * teeth;
-    gear->strips = (VertexStrip*)calloc(gear->nStrips, sizeof(*gear->vertices));
-
-    // Allocate the vertices
-    gear->vertices = (GearVertex*)calloc(VERTICES_PER_TOOTH * teeth,
-                                         sizeof(*gear->vertices));
-    vertex = gear->vertices;
-
-    // Calculate needed sin/cos for various angles
-    for (int i = 0; i < (int)teeth; ++i) {
-        double temp = (double)i * 2.0F * M_PI / teeth;
-        sincos(temp, &sinArr[0], &cosArr[0]);
-        sincos(temp + diameter, &sinArr[1], &cosArr[1]);
-        sincos(temp + diameter * 2, &sinArr[2], &cosArr[2]);
-        sincos(temp + diameter * 3, &sinArr[3], &cosArr[3]);
-        sincos(temp + diameter * 4, &sinArr[4], &cosArr[4]);
-
-        // Create 7 points (x,y coords) that make up a tooth
-        points[0] = GearPoint(rad2, 1);
-        points[1] = GearPoint(rad2, 2);
-        points[2] = GearPoint(rad1, 0);
-        points[3] = GearPoint(rad1, 3);
-        points[4] = GearPoint(rad0, 0);
-        points[5] = GearPoint(rad1, 4);
-        points[6] = GearPoint(rad0, 4);
-
-        // Front face
-        startStrip(gear, currentStrip);
-        setNormal(0, 0, 1.0);
-        gearVert(0, +1, gearWidth);
-        gearVert(1, +1, gearWidth);
-        gearVert(2, +1, gearWidth);
-        gearVert(3, +1, gearWidth);
-        gearVert(4, +1, gearWidth);
-        gearVert(5, +1, gearWidth);
-        gearVert(6, +1, gearWidth);
-        endStrip(gear, currentStrip);
-
-        // Inner face
-        startStrip(gear, currentStrip);
-        quadWithNormal(4, 6, gearWidth);
-        endStrip(gear, currentStrip);
-
-        // Back face
-        startStrip(gear, currentStrip);
-        setNormal(0, 0, -1.0);
-        gearVert(6, -1, gearWidth);
-        gearVert(5, -1, gearWidth);
-        gearVert(4, -1, gearWidth);
-        gearVert(3, -1, gearWidth);
-        gearVert(2, -1, gearWidth);
-        gearVert(1, -1, gearWidth);
-        gearVert(0, -1, gearWidth);
-        endStrip(gear, currentStrip);
-
-        // Outer face
-        startStrip(gear, currentStrip);
-        quadWithNormal(0, 2, gearWidth);
-        endStrip(gear, currentStrip);
-
-        startStrip(gear, currentStrip);
-        quadWithNormal(1, 0, gearWidth);
-        endStrip(gear, currentStrip);
-
-        startStrip(gear, currentStrip);
-        quadWithNormal(3, 1, gearWidth);
-        endStrip(gear, currentStrip);
-
-        startStrip(gear, currentStrip);
-        quadWithNormal(5, 3, gearWidth);
-        endStrip(gear, currentStrip);
+    Gear* gear = gearPool.create();
+    const GearParams params = {innerRad, outerRad, gearWidth, (int)teeth,
+                               toothDepth};
+
+    // Every level halves the teeth, a tooth has to cover
+    // GEAR_LOD_TOOTH_PIXELS for the level to be drawn
+    gear->lodCount = 0;
+    GearParams lodParams;
+    int finerTeeth = params.teeth;
+    while (gear->lodCount < GEAR_LOD_LEVELS &&
+           gearLodParams(params, gear->lodCount, &lodParams)) {
+        int level = gear->lodCount++;
+        // Gears of the same shape share one mesh
+        const GearMesh* mesh = meshes.get(lodParams, pGame->pJobs);
+        if (level == 0) {
+            gear->bounds = computeBounds(mesh->vertices, mesh->nVertices,
+                                         sizeof(GearVertex));
+        } else {
+            // The outline spans pi times the projected size
+            gear->chain.switchSize[level - 1] =
+                GEAR_LOD_TOOTH_PIXELS * (float)finerTeeth / (float)M_PI;
+        }
+        createGearLod(gear->lods[level], lodParams, mesh);
+        finerTeeth = lodParams.teeth;
     }
-
-    gear->nVertices = (int)(vertex - gear->vertices);
-    Graphics::storeVertexBufObj(
-        gear->vertexBufObj, (GLsizeiptr)(gear->nVertices * sizeof(GearVertex)),
-        (int*)gear->vertices);
+    gear->chain.levelCount = gear->lodCount;
+    gear->lod = 0;
 
     return gear;
 }
 
-void GearsScene::drawGear(Gear* gear,
-                          GLfloat* transform,
-                          GLfloat x,
-                          GLfloat y,
-                          GLfloat angle,
+void GearsScene::createGearLod(GearLod& lod,
+                               const GearParams& params,
+                               const GearMesh* mesh) {
+    lod.vertices = mesh->vertices;
+    lod.nVertices = mesh->nVertices;
+    lod.strips = mesh->strips;
+    lod.nStrips = mesh->nStrips;
+
+    // Only the first gear of a shape uploads it
+    GearMeshBuffers* buffers = meshes.getBuffers(params);
+    if (buffers->vertexArrayObj == 0) {
+        uploadGearMesh(*buffers, params, mesh);
+    }
+    lod.buffers = buffers;
+}
+
+void GearsScene::uploadGearMesh(GearMeshBuffers& buffers,
+                                const GearParams& params,
+                                const GearMesh* mesh) {
+    if (singleDraw) {
+        // A single draw uses an indexed triangle list, welded and ordered
+        // for the post-transform vertex cache
+        const OptimizedGearMesh* optimized =
+            meshes.getOptimized(params, pGame->pJobs);
+#ifdef DEBUG
+        fprintf(stderr, "Gear mesh: %d -> %d vertices, ACMR %.3f -> %.3f\n",
+                mesh->nVertices, optimized->nVertices, optimized->acmrBefore,
+                optimized->acmrAfter);
+#endif
+        if (packedVertices) {
+            Graphics::storeVertexBufObj(
+                buffers.vertexBufObj,
+                (GLsizeiptr)(optimized->nVertices * sizeof(PackedGearVertex)),
+                (const int*)optimized->packed);
+        } else {
+            Graphics::storeVertexBufObj(
+                buffers.vertexBufObj,
+                (GLsizeiptr)(optimized->nVertices * sizeof(GearVertex)),
+                (const int*)optimized->vertices);
+        }
+        buffers.nIndices = (GLsizei)optimized->nIndices;
+        Graphics::storeIndexBufObj(
+            buffers.indexBufObj,
+            (GLsizeiptr)(optimized->nIndices * sizeof(GLuint)),
+            optimized->indices);
+    } else if (packedVertices) {
+        std::vector<PackedGearVertex> packed(mesh->nVertices);
+        packGearVertices(mesh->vertices, mesh->nVertices, packed.data());
+        Graphics::storeVertexBufObj(
+            buffers.vertexBufObj,
+            (GLsizeiptr)(packed.size() * sizeof(PackedGearVertex)),
+            (const int*)packed.data());
+    } else {
+        Graphics::storeVertexBufObj(
+            buffers.vertexBufObj,
+            (GLsizeiptr)(mesh->nVertices * sizeof(GearVertex)),
+            (const int*)mesh->vertices);
+    }
+
+    // Record the vertex layout once, drawing only binds it from now on
+    InstanceStream streams[2];
+    getInstanceStreams(streams);
+    Graphics::createVertexArrayObj(
+        buffers.vertexArrayObj, buffers.vertexBufObj, buffers.indexBufObj, 0,
+        packedVertices ? PACKED_GEAR_VERTEX_LAYOUT : GEAR_VERTEX_LAYOUT,
+        streams, instanced ? 2 : 0);
+}
+
+DrawCommand GearsScene::gearCommand(const GearLod* gear,
+                                    int material,
+                                    const ObjectTransform& transform) const {
+    DrawCommand command = {};
+    // The w of the gear center is its distance from the eye
+    float depth = transform.modelViewProjection.m[15] / VIEW_FAR_PLANE;
+    command.key = makeSortKey(0, program->getSortId(), material,
+                              gear->buffers->vertexArrayObj, depth);
+    command.program = program;
+    command.vertexArrayObj = gear->buffers->vertexArrayObj;
+
+    // Draw the triangles or the strips that comprise the gear
+    if (gear->buffers->indexBufObj != 0) {
+        command.mode = GL_TRIANGLES;
+        command.indexCount = gear->buffers->nIndices;
+    } else {
+        command.mode = GL_TRIANGLE_STRIP;
+        command.stripCount = gear->nStrips;
+        command.strips = gear->strips;
+    }
+    return command;
+}
+
+void GearsScene::drawGear(CommandList* list,
+                          const GearLod* gear,
+                          int material,
+                          const ObjectTransform& transform,
                           const GLfloat color[4]) {
-    GLfloat modelView[16];
-    GLfloat normalMatrix[16];
-    GLfloat modelViewProjection[16];
-
-    // Translate and rotate the gear
-    memcpy(modelView, transform, sizeof(modelView));
-    Graphics::tlateMat4x4(modelView, x, y, 0);
-    Graphics::rotMat4x4(modelView, 2.0F * (float)M_PI * angle / 360.0F, 0, 0,
-                        1);
-
-    /* Create and set the ModelViewProjectionMatrix */
-    memcpy(modelViewProjection, projectionMatrix, sizeof(modelViewProjection));
-    Graphics::mulMat4x4(modelViewProjection, modelView);
-    Graphics::setUniformMatrixValue((GLint)modelViewProjectionMatrixLoc,
-                                    modelViewProjection);
-
-    /*
-     * Create and set the NormalMatrix. It's the inverse transpose of the
-     * ModelView matrix.
-     */
-    memcpy(normalMatrix, modelView, sizeof(normalMatrix));
-    Graphics::invMat4x4(normalMatrix);
-    Graphics::tposeMat4x4(normalMatrix);
-    Graphics::setUniformMatrixValue((GLint)normalMatrixLoc, normalMatrix);
+    DrawUniform uniforms[3];
+    uniforms[0] = {(GLint)modelViewProjectionMatrixLoc, 16, {}};
+    memcpy(uniforms[0].value, transform.modelViewProjection.m,
+           sizeof(GLfloat) * 16);
+    uniforms[1] = {(GLint)normalMatrixLoc, 16, {}};
+    memcpy(uniforms[1].value, transform.normal.m, sizeof(GLfloat) * 16);
 
     /* Set the gear color */
-    Graphics::setUniformValue((GLint)materialColorLoc, color);
+    uniforms[2] = {(GLint)materialColorLoc, 4, {}};
+    memcpy(uniforms[2].value, color, sizeof(GLfloat) * 4);
+
+    list->draw(gearCommand(gear, material, transform), uniforms, 3);
+}
+
+void GearsScene::drawGearBlock(CommandList* list,
+                               const GearLod* gear,
+                               int material,
+                               GLintptr objectBlock) {
+    DrawCommand command =
+        gearCommand(gear, material, transforms.data()[material]);
+    command.objectBlock = objectBlock;
+    command.objectBlockSize = sizeof(ObjectUniforms);
+    list->draw(command);
+}
+
+void GearsScene::getInstanceStreams(InstanceStream streams[2]) const {
+    // Matrices come from the transform batch, colors from the static buffer
+    streams[0] = {transformBufObj, transformOffset, INSTANCE_MVP_ATTR, 8,
+                  sizeof(ObjectTransform)};
+    streams[1] = {colorBufObj, 0, INSTANCE_COLOR_ATTR, 1,
+                  sizeof(GLfloat) * 4};
+}
 
-    // Draw the triangle strips that comprise the gear
-    Graphics::drawArrays(gear->vertexBufObj, GL_TRIANGLE_STRIP, gear->nStrips,
-                         gear->strips, 0, 2, 0, sizeof(GLfloat) * 3);
+void GearsScene::drawGearInstances(CommandList* list,
+                                   const GearLod* gear,
+                                   int first,
+                                   int count) {
+    DrawCommand command = gearCommand(gear, first, transforms.data()[first]);
+    command.streams = instanceStreams;
+    command.streamCount = 2;
+    command.firstInstance = first;
+    command.instanceCount = count;
+    list->draw(command);
+}
+
+const GearLod* GearsScene::selectGearLod(int gear) {
+    Gear* g = gears[gear];
+    // The w of the gear center is its distance from the eye
+    float depth = transforms.data()[gear].modelViewProjection.m[15];
+    float size = projectedSize(projectionMatrix, transforms.radius[gear],
+                               depth, (float)height);
+    g->lod = selectLod(g->chain, size, g->lod);
+    return &g->lods[g->lod];
 }
 
 void GearsScene::reshape() {
@@ -290,90 +467,210 @@ void GearsScene::reshape() {
         width = pGame->pWindow->getWidth();
         height = pGame->pWindow->getHeight();
 
-        Graphics::calcPersProjTform(projectionMatrix, 60.0,
-                                    (float)width / (float)height, 1.0, 1024.0);
-        glViewport(0, 0, (GLint)width, (GLint)height);
+        Graphics::calcPersProjTform(projectionMatrix.m, 60.0,
+                                    (float)width / (float)height, 1.0,
+                                    VIEW_FAR_PLANE);
+        Graphics::setViewport(0, 0, (GLint)width, (GLint)height);
     }
 }
 
 void GearsScene::idle() {
-    static int frames = 0;
-    static double tRot0 = -1.0;
-    static double tRate0 = -1.0;
-    double dt;
-    double t = SDL_GetTicks() / 1000.0;
-
-    if (tRot0 < 0.0) {
-        tRot0 = t;
-    }
-    dt = t - tRot0;
-    tRot0 = t;
-
-    /* advance rotation for next frame */
-    currentAngle += 70.0F * (GLfloat)dt; /* 70 degrees per second */
-    if (currentAngle > 3600.0) {
-        currentAngle -= 3600.0;
-    }
+    static Uint64 frequency = SDL_GetPerformanceFrequency();
+    static Uint64 tRate0 = SDL_GetPerformanceCounter();
+    static Uint64 tFrame = tRate0;
+    static FrameTimes frameTimes;
+    static FrameTimes gpuTimes;
+    static std::vector<GpuFrameTime> gpuFrames;
 
     pGame->pRenderer->draw();
-    frames++;
+    // Headless runs report every frame on their own
+    if (pGame->isHeadless()) {
+        return;
+    }
 
-    if (tRate0 < 0.0) {
-        tRate0 = t;
+    // Percentiles show the spikes an average hides
+    Uint64 t = SDL_GetPerformanceCounter();
+    frameTimes.add((double)(t - tFrame) * 1000.0 / (double)frequency);
+    tFrame = t;
+    pGame->pRenderer->gpuTimer.takeFinished(gpuFrames);
+    for (const GpuFrameTime& gpuFrame : gpuFrames) {
+        gpuTimes.add(gpuFrame.ms);
     }
-    if (t - tRate0 >= 5.0) {
-        auto seconds = (GLfloat)(t - tRate0);
-        GLfloat fps = (GLfloat)frames / seconds;
-        printf("%d frames in %3.1f seconds = %6.3f FPS\n", frames, seconds,
-               fps);
+
+    double seconds = (double)(t - tRate0) / (double)frequency;
+    if (seconds >= 5.0) {
+        printf("%zu frames in %3.1f seconds, frame p50 %.2f p95 %.2f p99 "
+               "%.2f ms",
+               frameTimes.size(), seconds, frameTimes.percentile(50.0),
+               frameTimes.percentile(95.0), frameTimes.percentile(99.0));
+        if (gpuTimes.size() > 0) {
+            printf(", GPU p50 %.2f p95 %.2f p99 %.2f ms",
+                   gpuTimes.percentile(50.0), gpuTimes.percentile(95.0),
+                   gpuTimes.percentile(99.0));
+        }
+        printf(
+            ", %u draw calls, %u skipped GL calls, %u visible, %u culled, "
+            "%u vertices\n",
+            Graphics::lastFrameStats.drawCalls,
+            Graphics::lastFrameStats.skippedCalls,
+            Graphics::lastFrameStats.visibleObjects,
+            Graphics::lastFrameStats.culledObjects,
+            Graphics::lastFrameStats.vertices);
         tRate0 = t;
-        frames = 0;
+        frameTimes.clear();
+        gpuTimes.clear();
     }
 }
 
-void GearsScene::keypress() {
+void GearsScene::keypress(double dt) {
     static const Uint8* keys = pGame->pInput->keys;
+    auto delta = (GLfloat)(VIEW_ROTATION_SPEED * dt);
     if (keys[SDL_SCANCODE_LEFT] || keys[SDL_SCANCODE_A]) {
-        viewRotation[1] += 5.0F;
+        viewRotation[1] += delta;
     }
     if (keys[SDL_SCANCODE_RIGHT] || keys[SDL_SCANCODE_D]) {
-        viewRotation[1] -= 5.0F;
+        viewRotation[1] -= delta;
     }
     if (keys[SDL_SCANCODE_UP] || keys[SDL_SCANCODE_W]) {
-        viewRotation[0] += 5.0F;
+        viewRotation[0] += delta;
     }
     if (keys[SDL_SCANCODE_DOWN] || keys[SDL_SCANCODE_S]) {
-        viewRotation[0] -= 5.0F;
+        viewRotation[0] -= delta;
     }
 }
 
-void GearsScene::draw() {
+void GearsScene::update(double dt) {
+    for (int i = 0; i < 3; ++i) {
+        prevViewRotation[i] = viewRotation[i];
+    }
+    prevAngle = currentAngle;
+
+    keypress(dt);
+
+    /* advance rotation for next frame */
+    currentAngle += GEAR_ROTATION_SPEED * (GLfloat)dt;
+    if (currentAngle > 3600.0) {
+        // Wrap both so the interpolation does not spin back
+        currentAngle -= 3600.0;
+        prevAngle -= 3600.0;
+    }
+
+    // Keep the spatial index up with the turning gears
+    for (int i = 0; i < 3; ++i) {
+        moveNode(gearNodes[i],
+                 placeBox(gears[i]->bounds.box, gearPositions[i],
+                          gearAngle(i, currentAngle)));
+    }
+}
+
+void GearsScene::publish() {
+    for (int i = 0; i < 3; ++i) {
+        packet.viewRotation[i] = viewRotation[i];
+        packet.prevViewRotation[i] = prevViewRotation[i];
+    }
+    packet.angle = currentAngle;
+    packet.prevAngle = prevAngle;
+}
+
+void GearsScene::render(double alpha) {
+    PROFILE_ZONE("GearsScene::render");
     const static GLfloat red[4] = {0.8, 0.1, 0.0, 1.0};
     const static GLfloat green[4] = {0.0, 0.8, 0.2, 1.0};
     const static GLfloat blue[4] = {0.2, 0.2, 1.0, 1.0};
-    GLfloat transform[16];
+    auto a = (GLfloat)alpha;
+    GLfloat* transform = transforms.parents[0].m;
+    GLfloat rotation[3];
+    for (int i = 0; i < 3; ++i) {
+        rotation[i] = packet.prevViewRotation[i] +
+                      (packet.viewRotation[i] - packet.prevViewRotation[i]) * a;
+    }
+    GLfloat angle = packet.prevAngle + (packet.angle - packet.prevAngle) * a;
     Graphics::identMat4x4(transform);
 
+    /* Culling and detail levels need the projection of this frame */
+    reshape();
+
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     /* Translate and rotate the view */
     Graphics::tlateMat4x4(transform, 0, 0, -20);
-    Graphics::rotMat4x4(transform,
-                        2.0F * (float)M_PI * viewRotation[0] / 360.0F, 1, 0, 0);
-    Graphics::rotMat4x4(transform,
-                        2.0F * (float)M_PI * viewRotation[1] / 360.0F, 0, 1, 0);
-    Graphics::rotMat4x4(transform,
-                        2.0F * (float)M_PI * viewRotation[2] / 360.0F, 0, 0, 1);
-
-    /* Draw the gears */
-    drawGear(gears[0], transform, -3.0, -2.0, currentAngle, red);
-    drawGear(gears[1], transform, 3.1, -2.0, (float)-2 * currentAngle - 9.0F,
-             green);
-    drawGear(gears[2], transform, -3.1, 4.2, (float)-2 * currentAngle - 25.0F,
-             blue);
+    Graphics::rotMat4x4(transform, 2.0F * (float)M_PI * rotation[0] / 360.0F,
+                        1, 0, 0);
+    Graphics::rotMat4x4(transform, 2.0F * (float)M_PI * rotation[1] / 360.0F,
+                        0, 1, 0);
+    Graphics::rotMat4x4(transform, 2.0F * (float)M_PI * rotation[2] / 360.0F,
+                        0, 0, 1);
+
+    /* Compute the matrices of all gears in one go */
+    for (int i = 0; i < 3; ++i) {
+        transforms.angle[i] = gearAngle(i, angle);
+    }
+    transforms.compute(projectionMatrix, pGame->pJobs);
+
+    /* Leave out the gears outside the view */
+    int visibleCount = transforms.cull(projectionMatrix);
+    const std::vector<int>& visible = transforms.visible();
+    Graphics::stats.visibleObjects += visibleCount;
+    Graphics::stats.culledObjects += transforms.size() - visibleCount;
+
+    /* Queue the gears, they are drawn when the frame is presented */
+    CommandList* list = pGame->pRenderer->queue.beginList();
+    const GLfloat* colors[3] = {red, green, blue};
+    if (path == GearsPath::Uniforms) {
+        for (int i : visible) {
+            drawGear(list, selectGearLod(i), i, transforms.data()[i],
+                     colors[i]);
+        }
+    } else {
+        UniformRing& uniforms = pGame->pRenderer->uniforms;
+
+        // Every block of the frame goes up in a single write
+        FrameUniforms frame;
+        frame.view = transforms.parents[0];
+        frame.projection = projectionMatrix;
+        memcpy(frame.lightSourcePos, lightSourcePos, sizeof(lightSourcePos));
+        GLintptr frameBlock = uniforms.push(&frame, sizeof(frame));
+
+        GLintptr objectBlocks[3];
+        if (path == GearsPath::UniformBlocks) {
+            for (int i : visible) {
+                ObjectUniforms object;
+                object.transform = transforms.data()[i];
+                memcpy(object.materialColor, colors[i],
+                       sizeof(object.materialColor));
+                objectBlocks[i] = uniforms.push(&object, sizeof(object));
+            }
+        }
+        uniforms.upload();
+        uniforms.bind(FRAME_BLOCK_BINDING, frameBlock, sizeof(frame));
+
+        if (path == GearsPath::UniformBlocks) {
+            for (int i : visible) {
+                drawGearBlock(list, selectGearLod(i), i, objectBlocks[i]);
+            }
+        } else {
+            // One write for the matrices of every gear
+            auto size =
+                (GLsizeiptr)(transforms.size() * sizeof(ObjectTransform));
+            StreamAlloc dest = pGame->pRenderer->vertexStream.alloc(size);
+            if (dest.data != nullptr) {
+                memcpy(dest.data, transforms.data(), size);
+                pGame->pRenderer->vertexStream.flush();
+                transformBufObj = dest.bufObj;
+                transformOffset = dest.offset;
+            } else {
+                Graphics::uploadBuffer(overflowBufObj, GL_ARRAY_BUFFER, size,
+                                       transforms.data());
+                transformBufObj = overflowBufObj;
+                transformOffset = 0;
+            }
+            getInstanceStreams(instanceStreams);
+            for (int i : visible) {
+                drawGearInstances(list, selectGearLod(i), i, 1);
+            }
+        }
+    }
 
-    reshape();
-    keypress();
     idle();
 }
\ No newline at end of file
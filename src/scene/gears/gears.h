@@ -17,88 +17,144 @@
 
 #include <GLES3/gl3.h>
 #include <GL/glew.h>
+#include <graphics/culling.h>
+#include <graphics/graphics.h>
+#include <graphics/lod.h>
+#include <graphics/shader.h>
+#include <graphics/transform.h>
+#include <graphics/uniforms.h>
+#include <memory/pool.h>
+#include <scene/gears/gearmesh.h>
 #include <scene/scene.h>
 
-#define STRIPS_PER_TOOTH 7
-#define VERTICES_PER_TOOTH 34
-#define GEAR_VERTEX_STRIDE 6
+// Rotation speeds in degrees per second
+#define GEAR_ROTATION_SPEED 70.0F
+#define VIEW_ROTATION_SPEED 300.0
 
-struct VertexStrip;
+// Distance of the far clipping plane
+#define VIEW_FAR_PLANE 1024.0F
 
-// Each vertex consists of GEAR_VERTEX_STRIDE GLfloat attributes
-using GearVertex = GLfloat[GEAR_VERTEX_STRIDE];
+// Attribute locations of the per-instance data in the instanced shader,
+// the matrices take four locations each
+#define INSTANCE_MVP_ATTR 2
+#define INSTANCE_NORMAL_ATTR 6
+#define INSTANCE_COLOR_ATTR 10
 
-// Class representing a gear
-using Gear = struct {
-    // Array of vertices comprising the gear
-    GearVertex* vertices;
+// Variant of the block shader reading per-instance attributes
+#define GEAR_VARIANT_INSTANCED (1U << 0)
+
+// Smallest on-screen width in pixels a tooth may shrink to before the
+// gear switches to the level with half the teeth
+#define GEAR_LOD_TOOTH_PIXELS 4.0F
+
+// One detail level of a gear
+using GearLod = struct GearLod {
+    // Array of vertices comprising the gear, shared with the mesh cache
+    const GearVertex* vertices;
     // Number of vertices comprising the gear
     int nVertices;
-    // Array of triangle strips comprising the gear
-    VertexStrip* strips;
+    // Array of triangle strips comprising the gear, shared with the mesh
+    // cache
+    const VertexStrip* strips;
     // Number of triangle strips comprising the gear
     int nStrips;
-    // Vertex buffer object holding the vertices in the GPU
-    GLuint vertexBufObj;
+    // The GPU copy of the mesh, shared with the mesh cache
+    const GearMeshBuffers* buffers;
 };
 
-using Point = struct {
-    GLfloat x;
-    GLfloat y;
+// Class representing a gear
+using Gear = struct {
+    // The detail levels, 0 being the full gear
+    GearLod lods[GEAR_LOD_LEVELS];
+    int lodCount;
+    // When to switch between the levels
+    LodChain chain;
+    // The level drawn last frame
+    int lod;
+    // Bounding volumes of the full mesh
+    Bounds bounds;
+};
+
+// How the per-gear data reaches the shader
+enum class GearsPath {
+    // Separate glUniform* calls per gear
+    Uniforms,
+    // std140 uniform blocks, one range of the uniform ring per gear
+    UniformBlocks,
+    // Per-instance attributes, matrices uploaded once per frame
+    Instanced,
+};
+
+// State render needs, copied out of the simulation after every batch of
+// updates so the two can run on different threads
+using GearsPacket = struct GearsPacket {
+    GLfloat viewRotation[3];
+    GLfloat prevViewRotation[3];
+    GLfloat angle;
+    GLfloat prevAngle;
 };
 
 class GearsScene : public Scene {
     // Second set of screen resolution to keep track
     // of window resize
-    int width;
-    int height;
+    int width = 0;
+    int height = 0;
     // The view rotation [x, y, z]
     GLfloat viewRotation[3] = {20.0, 30.0, 0.0};
+    // The view rotation of the previous update
+    GLfloat prevViewRotation[3] = {20.0, 30.0, 0.0};
     // The gears
     Gear* gears[3];
+    // The gears in the spatial index of the scene
+    SceneNode* gearNodes[3];
+    Pool<Gear> gearPool{&arena};
+    // Meshes of the gears, kept in the scene arena
+    GearMeshCache meshes{&arena};
     // The current gear rotation angle
     GLfloat currentAngle = 0.0;
+    // The gear rotation angle of the previous update
+    GLfloat prevAngle = 0.0;
+    // What the last publish handed over to render
+    GearsPacket packet = {};
+    // The shaders of the gears and the variant in use
+    ShaderVariants shaders;
+    ShaderProgram* program;
     // The location of the shader uniforms
     GLuint modelViewProjectionMatrixLoc;
     GLuint normalMatrixLoc;
     GLuint lightSrcPosLoc;
     GLuint materialColorLoc;
     // The projection matrix
-    GLfloat projectionMatrix[16];
-
-    GearVertex* vertex;
-    double sinArr[5];
-    double cosArr[5];
-    GLfloat normal[3];
-    Point points[7];
-
-    Point GearPoint(GLfloat radius, int diameter);
-    void gearVert(int point, int sign, GLfloat gearWidth);
-    void setNormal(GLfloat x, GLfloat y, GLfloat z);
-    void quadWithNormal(int p1, int p2, GLfloat gearWidth);
-    void startStrip(Gear* gear, int& currentStrip);
-    void endStrip(Gear* gear, int& currentStrip);
+    Mat4 projectionMatrix;
+    // Placement of every gear relative to the view
+    TransformBatch transforms;
+    // The way the gears are fed to the shader
+    GearsPath path;
+    // Whether the gears are drawn through the instanced shader
+    bool instanced;
+    // Whether the vertex buffers hold PackedGearVertex instead of
+    // GearVertex
+    bool packedVertices;
+    // Whether the strips are turned into an optimized indexed triangle
+    // list so every gear is drawn with a single call
+    bool singleDraw = true;
+    // Per-instance buffers of the instanced path, the matrices live in
+    // the vertex stream of the renderer
+    GLuint transformBufObj = 0;
+    GLintptr transformOffset = 0;
+    GLuint colorBufObj = 0;
+    // Streams the instanced draws of the frame read from
+    InstanceStream instanceStreams[2];
+    // Holds the matrices when they do not fit in the stream
+    GLuint overflowBufObj = 0;
 
     void idle();
     void reshape();
-    void keypress();
+    void keypress(double dt);
 
     // The direction of the directional light for the scene
     const GLfloat lightSourcePos[4] = {5.0, 5.0, 10.0, 1.0};
 
-    /**
-     * Fills a gear vertex.
-     *
-     * @param gearVertex the vertex to fill
-     * @param x the x coordinate
-     * @param y the y coordinate
-     * @param z the z coordinate
-     * @param n pointer to the normal table
-     *
-     * @return the operation error code
-     */
-    void fillGearVertex(GLfloat x, GLfloat y, GLfloat z, const GLfloat n[3]);
-
     /**
      * Create a gear wheel.
      *
@@ -116,21 +172,101 @@ class GearsScene : public Scene {
                      GLfloat teeth,
                      GLfloat toothDepth);
 
+    /**
+     * Fills in a detail level of a gear, uploading its mesh when no gear
+     * of the same shape did yet.
+     *
+     * @param[out] lod the level to fill in
+     * @param params the shape of the level
+     * @param mesh the mesh of the level
+     */
+    void createGearLod(GearLod& lod,
+                       const GearParams& params,
+                       const GearMesh* mesh);
+
+    /**
+     * Uploads the mesh of a gear shape.
+     *
+     * @param[out] buffers where to keep the GPU objects
+     * @param params the shape of the gear
+     * @param mesh the mesh of the shape
+     */
+    void uploadGearMesh(GearMeshBuffers& buffers,
+                        const GearParams& params,
+                        const GearMesh* mesh);
+
+    /**
+     * Fills in the parts of a draw every path shares.
+     *
+     * @param gear the detail level of the gear to draw
+     * @param material the color index of the gear
+     * @param transform the matrices computed for the gear
+     */
+    DrawCommand gearCommand(const GearLod* gear,
+                            int material,
+                            const ObjectTransform& transform) const;
+
     /**
      * Draws a gear
      *
-     * @param transform the current transformation matrix
-     * @param x the x pos to draw the gear at
-     * @param y the y pos to draw the gear at
-     * @param angle the rotation angle of the gear
+     * @param list the list to record the draw into
+     * @param gear the detail level of the gear to draw
+     * @param material the color index of the gear
+     * @param transform the matrices computed for the gear
      * @param color the color of the gear
      */
-    void drawGear(Gear*, GLfloat*, GLfloat, GLfloat, GLfloat, const GLfloat[4]);
+    void drawGear(CommandList* list,
+                  const GearLod* gear,
+                  int material,
+                  const ObjectTransform& transform,
+                  const GLfloat color[4]);
+
+    /**
+     * Draws a gear with its data in the ObjectBlock uniform block
+     *
+     * @param list the list to record the draw into
+     * @param gear the detail level of the gear to draw
+     * @param material the color index of the gear
+     * @param objectBlock the offset of the gear block in the uniform ring
+     */
+    void drawGearBlock(CommandList* list,
+                       const GearLod* gear,
+                       int material,
+                       GLintptr objectBlock);
+
+    // Fills in the per-instance streams of the instanced shader
+    void getInstanceStreams(InstanceStream streams[2]) const;
+
+    /**
+     * Draws instances of a gear, reading the matrices and the colors from
+     * the per-instance buffers.
+     *
+     * @param list the list to record the draw into
+     * @param gear the detail level of the gear to draw
+     * @param first the first instance to draw
+     * @param count the number of instances to draw
+     */
+    void drawGearInstances(CommandList* list,
+                           const GearLod* gear,
+                           int first,
+                           int count);
+
+    /**
+     * Picks the detail level of a gear for this frame.
+     *
+     * @param gear the index of the gear
+     *
+     * @return the level to draw
+     */
+    const GearLod* selectGearLod(int gear);
 
     // Draws all gears
     void drawAllGears();
 
    public:
     GearsScene(Game*);
-    void draw() override;
+    ~GearsScene() override;
+    void update(double dt) override;
+    void publish() override;
+    void render(double alpha) override;
 };
\ No newline at end of file
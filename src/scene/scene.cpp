@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2023, Furkan Mudanyali <fmudanyali@icloud.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <scene/scene.h>
+
+SceneNode* Scene::addNode(const Aabb& box, int object) {
+    SceneNode* node = this->nodes.create();
+    node->box = box;
+    node->object = object;
+    node->proxy = this->spatial.insert(box, object);
+    return node;
+}
+
+void Scene::moveNode(SceneNode* node, const Aabb& box) {
+    node->box = box;
+    this->spatial.update(node->proxy, box);
+}
+
+void Scene::removeNode(SceneNode* node) {
+    this->spatial.remove(node->proxy);
+    this->nodes.destroy(node);
+}
@@ -18,16 +18,77 @@
 #ifndef _HOMD_SCENE
 #define _HOMD_SCENE
 
+#include <memory/arena.h>
+#include <memory/pool.h>
+#include <scene/bvh.h>
+
 class Game;
 
+// An object of a scene placed in the spatial index of the scene
+using SceneNode = struct SceneNode {
+    // Box of the object in the space of the scene
+    Aabb box;
+    // What queries of the spatial index hand back for the node
+    int object;
+    // Handle of the node in the spatial index
+    int proxy;
+};
+
 class Scene {
    public:
     Game* pGame;
+    // Memory of the scene, released in one go when the scene is popped
+    Arena arena;
+    // Boxes of the nodes, for frustum, ray and nearest object queries
+    Bvh spatial;
 
     bool destroy = false;
     Scene() = default;
     virtual ~Scene() = default;
-    virtual void draw() = 0;
+
+    /**
+     * Advances the simulation by one fixed step. May run on a worker
+     * thread, so it must not touch GL or anything render reads.
+     *
+     * @param dt the length of the step in seconds
+     */
+    virtual void update(double dt) = 0;
+
+    /**
+     * Copies the state the updates produced into the render packet, the
+     * only thing render reads. Called on the main thread while no update
+     * is running.
+     */
+    virtual void publish() = 0;
+
+    /**
+     * Draws the scene from the render packet.
+     *
+     * @param alpha how far between the last two updates the frame is, from
+     * 0 to 1, to interpolate the drawn state with
+     */
+    virtual void render(double alpha) = 0;
+
+   protected:
+    Pool<SceneNode> nodes{&arena};
+
+    /**
+     * Places an object in the spatial index.
+     *
+     * @param box the box of the object
+     * @param object what queries hand back for the object
+     */
+    SceneNode* addNode(const Aabb& box, int object);
+
+    /**
+     * Moves a node, the spatial index refits in place when it can.
+     *
+     * @param node the node
+     * @param box the new box of the object
+     */
+    void moveNode(SceneNode* node, const Aabb& box);
+
+    void removeNode(SceneNode* node);
 };
 
 #endif
\ No newline at end of file
@@ -15,17 +15,33 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <SDL2/SDL_hints.h>
+#include <game/game.h>
 #include <window/window.h>
 
 Window::Window(Game* pGame) {
     this->game = pGame;
+    if (pGame->isHeadless()) {
+        // The offscreen driver makes an EGL context without a display
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, HEADLESS_VIDEO_DRIVER);
+    }
     if (SDL_Init(SDL_FLAGS) != 0) {
         throw SDL_GetError();
     }
 
-    this->window = SDL_CreateWindow(WINDOW_TITLE, SDL_WINDOWPOS_CENTERED,
-                                    SDL_WINDOWPOS_CENTERED, WINDOW_INITIAL_W,
-                                    WINDOW_INITIAL_H, SDL_WINDOW_FLAGS);
+    if (pGame->isHeadless()) {
+        const HeadlessConfig& config = pGame->getHeadlessConfig();
+        this->window = SDL_CreateWindow(
+            WINDOW_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+            config.width, config.height, SDL_HEADLESS_WINDOW_FLAGS);
+    } else {
+        this->window = SDL_CreateWindow(
+            WINDOW_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+            WINDOW_INITIAL_W, WINDOW_INITIAL_H, SDL_WINDOW_FLAGS);
+    }
+    if (this->window == nullptr) {
+        throw SDL_GetError();
+    }
 }
 
 Window::~Window() {
@@ -34,6 +50,12 @@ Window::~Window() {
 }
 
 void Window::updateDimensions() {
+    if (this->game->isHeadless()) {
+        // The offscreen target does not follow the window
+        this->width = this->game->getHeadlessConfig().width;
+        this->height = this->game->getHeadlessConfig().height;
+        return;
+    }
     SDL_GL_GetDrawableSize(this->window, &this->width, &this->height);
 }
 
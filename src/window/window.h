@@ -29,6 +29,10 @@
 #define WINDOW_TITLE "Homd Engine"
 #define WINDOW_INITIAL_W 960
 #define WINDOW_INITIAL_H 540
+// A headless run keeps a hidden window of the target size for the context
+#define SDL_HEADLESS_WINDOW_FLAGS SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN
+// Video driver that needs no display, SDL_VIDEODRIVER still wins over it
+#define HEADLESS_VIDEO_DRIVER "offscreen"
 
 class Game;
 